@@ -0,0 +1,291 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <RTOScppBuffer.h>
+#include <RTOScppLock.h>
+#include <RTOScppQueue.h>
+#include <RTOScppRingBuffer.h>
+#include <RTOScppTask.h>
+#include <Arduino.h>
+#include <atomic>
+#include <esp_timer.h>
+
+// Micro benchmarks of the wrappers against the raw FreeRTOS calls behind them. Every case prints a
+// CSV line, so runs of different releases can be compared by a script:
+//
+//   bench,<case>,<api>,<iterations>,<cycles_per_op>,<ops_per_s>
+//
+// api is "wrapper", "crtp" (devirtualized locks) or "raw". Cycles come from the CPU cycle counter
+// of the calling core. Benchmark.ino runs every case once at boot
+class Benchmark {
+  public:
+  Benchmark(Print& out, const uint32_t iterations = 10000)
+      : _out(out)
+      , _iterations(iterations ? iterations : 1) {}
+
+  Benchmark(const Benchmark&)                = delete;
+  Benchmark& operator=(const Benchmark&)     = delete;
+  Benchmark(Benchmark&&) noexcept            = delete;
+  Benchmark& operator=(Benchmark&&) noexcept = delete;
+
+  void runAll() {
+    printHeader();
+    queue();
+    ringBuffers();
+    dataBuffers();
+    locks();
+    lockContention();
+    notify();
+  }
+
+  void printHeader() { _out.println("bench,case,api,iterations,cycles_per_op,ops_per_s"); }
+
+  // Add followed by pop on an empty queue
+  void queue() {
+    QueueStatic<uint32_t, 8> queue;
+    const QueueHandle_t handle = queue.getHandle();
+    uint32_t value             = 0;
+
+    _measure("queue_add_pop", "wrapper", [&]() {
+      queue.add(value, 0);
+      queue.pop(value, 0);
+    });
+
+    _measure("queue_add_pop", "raw", [&]() {
+      xQueueSendToBack(handle, &value, 0);
+      xQueueReceive(handle, &value, 0);
+    });
+  }
+
+  // Send, receive and return of a 4 byte item on every ring buffer type
+  void ringBuffers() {
+    const uint32_t value = 0;
+    size_t size          = 0;
+
+    RingBufferNoSplitStatic<uint32_t, 8> no_split;
+    const RingbufHandle_t no_split_handle = no_split.getHandle();
+
+    _measure("ringbuf_nosplit_send_receive", "wrapper", [&]() {
+      no_split.send(&value, sizeof(value), 0);
+      no_split.receiveItem(0).release();
+    });
+
+    _measure("ringbuf_nosplit_send_receive", "raw", [&]() {
+      xRingbufferSend(no_split_handle, &value, sizeof(value), 0);
+      void* item = xRingbufferReceive(no_split_handle, &size, 0);
+      if (item) vRingbufferReturnItem(no_split_handle, item);
+    });
+
+    RingBufferSplitStatic<uint32_t, 8> split;
+    const RingbufHandle_t split_handle = split.getHandle();
+
+    _measure("ringbuf_split_send_receive", "wrapper", [&]() {
+      split.send(&value, sizeof(value), 0);
+      split.receiveItem(0).release();
+    });
+
+    _measure("ringbuf_split_send_receive", "raw", [&]() {
+      void* head       = nullptr;
+      void* tail       = nullptr;
+      size_t tail_size = 0;
+      xRingbufferSend(split_handle, &value, sizeof(value), 0);
+      if (!xRingbufferReceiveSplit(split_handle, &head, &tail, &size, &tail_size, 0)) return;
+      vRingbufferReturnItem(split_handle, head);
+      if (tail) vRingbufferReturnItem(split_handle, tail);
+    });
+
+    RingBufferByteStatic<uint8_t, 64> bytes;
+    const RingbufHandle_t bytes_handle = bytes.getHandle();
+    const uint8_t* const data          = reinterpret_cast<const uint8_t*>(&value);
+
+    _measure("ringbuf_byte_send_receive", "wrapper", [&]() {
+      bytes.send(data, sizeof(value), 0);
+      bytes.receiveItemUpTo(sizeof(value), 0).release();
+    });
+
+    _measure("ringbuf_byte_send_receive", "raw", [&]() {
+      xRingbufferSend(bytes_handle, data, sizeof(value), 0);
+      void* item = xRingbufferReceiveUpTo(bytes_handle, &size, 0, sizeof(value));
+      if (item) vRingbufferReturnItem(bytes_handle, item);
+    });
+  }
+
+  // Send followed by receive of 4 bytes on a stream buffer and a message buffer
+  void dataBuffers() {
+    uint32_t value = 0;
+
+    StreamBufferStatic<64> stream(1);
+    MessageBufferStatic<64> message;
+    const StreamBufferHandle_t stream_handle  = stream.getHandle();
+    const StreamBufferHandle_t message_handle = message.getHandle();
+
+    _measure("streambuf_send_receive", "wrapper", [&]() {
+      stream.send(&value, sizeof(value), 0);
+      stream.receive(&value, sizeof(value), 0);
+    });
+
+    _measure("streambuf_send_receive", "raw", [&]() {
+      xStreamBufferSend(stream_handle, &value, sizeof(value), 0);
+      xStreamBufferReceive(stream_handle, &value, sizeof(value), 0);
+    });
+
+    _measure("msgbuf_send_receive", "wrapper", [&]() {
+      message.send(&value, sizeof(value), 0);
+      message.receive(&value, sizeof(value), 0);
+    });
+
+    _measure("msgbuf_send_receive", "raw", [&]() {
+      xStreamBufferSend(message_handle, &value, sizeof(value), 0);
+      xStreamBufferReceive(message_handle, &value, sizeof(value), 0);
+    });
+  }
+
+  // Uncontended take followed by give, through the virtual LockInterface::take on the wrapper side
+  void locks() {
+    MutexStatic mutex;
+    SemaphoreBinaryStatic semaphore;
+    const LockInterface& mutex_lock          = mutex;
+    const LockInterface& semaphore_lock      = semaphore;
+    const SemaphoreHandle_t mutex_handle     = mutex.getHandle();
+    const SemaphoreHandle_t semaphore_handle = semaphore.getHandle();
+    semaphore.give();
+
+    _measure("mutex_take_give", "wrapper", [&]() {
+      mutex_lock.take(0);
+      mutex_lock.give();
+    });
+
+    _measure("mutex_take_give", "raw", [&]() {
+      xSemaphoreTake(mutex_handle, 0);
+      xSemaphoreGive(mutex_handle);
+    });
+
+    MutexStaticCRTP mutex_crtp;
+
+    _measure("mutex_take_give", "crtp", [&]() {
+      mutex_crtp.take(0);
+      mutex_crtp.give();
+    });
+
+    _measure("semaphore_take_give", "wrapper", [&]() {
+      semaphore_lock.take(0);
+      semaphore_lock.give();
+    });
+
+    _measure("semaphore_take_give", "raw", [&]() {
+      xSemaphoreTake(semaphore_handle, 0);
+      xSemaphoreGive(semaphore_handle);
+    });
+  }
+
+  // Take followed by give while a task of the same priority does the same on the same core and,
+  // on dual core chips, on the other core
+  void lockContention() {
+    _contention("mutex_contended_same_core", xPortGetCoreID());
+#if portNUM_PROCESSORS > 1
+    _contention("mutex_contended_cross_core", !xPortGetCoreID());
+#endif
+  }
+
+  // Round trip of a task notification to a task that answers with another one. Half of it is the
+  // notify latency
+  void notify() {
+    _notify("notify_round_trip_same_core", xPortGetCoreID());
+#if portNUM_PROCESSORS > 1
+    _notify("notify_round_trip_cross_core", !xPortGetCoreID());
+#endif
+  }
+
+  private:
+  struct _Peer {
+    std::atomic<bool> stop;
+    std::atomic<bool> done;
+    SemaphoreHandle_t mutex;
+    TaskHandle_t caller;
+  };
+
+  template <typename F>
+  void _measure(const char* name, const char* api, F&& body) {
+    body();
+
+    const int64_t start_us      = esp_timer_get_time();
+    const uint32_t start_cycles = ESP.getCycleCount();
+
+    for (uint32_t i = 0; i < _iterations; i++) body();
+
+    const uint32_t cycles = ESP.getCycleCount() - start_cycles;
+    const int64_t us      = esp_timer_get_time() - start_us;
+
+    _out.printf("bench,%s,%s,%u,%u,%u\n", name, api, (unsigned)_iterations,
+                (unsigned)(cycles / _iterations),
+                (unsigned)(us > 0 ? (uint64_t)_iterations * 1000000 / us : 0));
+  }
+
+  void _contention(const char* name, const BaseType_t core) {
+    MutexStatic mutex;
+    const LockInterface& lock = mutex;
+    _Peer peer;
+    peer.stop  = false;
+    peer.done  = false;
+    peer.mutex = mutex.getHandle();
+
+    TaskDynamic task("bench", [&peer]() {
+      while (!peer.stop.load(std::memory_order_relaxed)) {
+        xSemaphoreTake(peer.mutex, portMAX_DELAY);
+        xSemaphoreGive(peer.mutex);
+      }
+      peer.done = true;
+      vTaskSuspend(nullptr);
+    }, uxTaskPriorityGet(nullptr), 2048, core);
+
+    if (!task.init()) return;
+
+    _measure(name, "wrapper", [&]() {
+      lock.take(portMAX_DELAY);
+      lock.give();
+    });
+
+    _measure(name, "raw", [&]() {
+      xSemaphoreTake(peer.mutex, portMAX_DELAY);
+      xSemaphoreGive(peer.mutex);
+    });
+
+    // The peer must be out of the mutex before the task and the mutex are deleted
+    peer.stop = true;
+    while (!peer.done) vTaskDelay(1);
+  }
+
+  void _notify(const char* name, const BaseType_t core) {
+    _Peer peer;
+    peer.stop   = false;
+    peer.done   = false;
+    peer.caller = xTaskGetCurrentTaskHandle();
+
+    TaskDynamic task("bench", [&peer]() {
+      while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        xTaskNotifyGive(peer.caller);
+      }
+    }, uxTaskPriorityGet(nullptr), 2048, core);
+
+    if (!task.init()) return;
+
+    _measure(name, "wrapper", [&]() {
+      task.notifyGive();
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    });
+
+    _measure(name, "raw", [&]() {
+      xTaskNotifyGive(task.getHandle());
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    });
+  }
+
+  Print& _out;
+  const uint32_t _iterations;
+};
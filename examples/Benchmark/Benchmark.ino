@@ -0,0 +1,19 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "Benchmark.h"
+#include <Arduino.h>
+
+// Prints the CSV results of every case once at boot. Built from the library root with e.g.
+// pio ci examples/Benchmark --lib . --board esp32dev, keep the output of each release to compare
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  Benchmark(Serial).runAll();
+}
+
+void loop() { vTaskDelay(portMAX_DELAY); }
@@ -0,0 +1,210 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "RTOScppNotify.h"
+#include <Arduino.h>
+#include <atomic>
+#include <type_traits>
+
+// One to many channel: every item is stored once in a shared ring of LENGTH items and each
+// subscriber reads it through its own cursor, so publishing costs one copy whatever the number of
+// subscribers. Publishing never blocks, a subscriber that lags more than LENGTH - 1 items loses
+// the oldest ones and getDropped() tells how many.
+//
+// Blocked subscribers sleep on their task notification (RTOSCPP_NOTIFY_DEFAULT_INDEX) and are
+// woken by the publisher only while they wait. receive() must be called from the subscribed task.
+template <typename T, uint32_t LENGTH, uint8_t MAX_SUBSCRIBERS>
+class BroadcastChannel {
+  static_assert(LENGTH > 1 && (LENGTH & (LENGTH - 1)) == 0, "LENGTH must be a power of two");
+  static_assert(MAX_SUBSCRIBERS > 0 && MAX_SUBSCRIBERS <= 32,
+                "MAX_SUBSCRIBERS must be between 1 and 32");
+  static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+
+  public:
+  BroadcastChannel()
+      : _head(0)
+      , _waiting(0)
+      , _subscribers{} {
+    portMUX_INITIALIZE(&_mux);
+  }
+
+  BroadcastChannel(const BroadcastChannel&)                = delete;
+  BroadcastChannel& operator=(const BroadcastChannel&)     = delete;
+  BroadcastChannel(BroadcastChannel&&) noexcept            = delete;
+  BroadcastChannel& operator=(BroadcastChannel&&) noexcept = delete;
+
+  // Subscribes the calling task, which only sees the items published from now on. Returns the
+  // subscriber id, or -1 if there are already MAX_SUBSCRIBERS
+  int8_t subscribe() {
+    int8_t id = -1;
+
+    portENTER_CRITICAL(&_mux);
+    for (uint8_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+      _Subscriber& subscriber = _subscribers[i];
+      if (subscriber.task) continue;
+
+      subscriber.task    = xTaskGetCurrentTaskHandle();
+      subscriber.cursor  = _head.load(std::memory_order_relaxed);
+      subscriber.dropped = 0;
+      id                 = i;
+      break;
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    return id;
+  }
+
+  void unsubscribe(const uint8_t id) {
+    if (id >= MAX_SUBSCRIBERS) return;
+
+    portENTER_CRITICAL(&_mux);
+    _subscribers[id].task = nullptr;
+    _waiting.fetch_and(~(1UL << id), std::memory_order_relaxed);
+    portEXIT_CRITICAL(&_mux);
+  }
+
+  void publish(const T& item) {
+    portENTER_CRITICAL(&_mux);
+    _write(item);
+    portEXIT_CRITICAL(&_mux);
+
+    uint32_t waiting = _takeWaiting();
+    while (waiting) {
+      const TaskHandle_t task = _subscribers[__builtin_ctz(waiting)].task;
+      waiting &= waiting - 1;
+      if (task == nullptr) continue;
+      xTaskNotifyGiveIndexed(task, RTOSCPP_NOTIFY_DEFAULT_INDEX);
+    }
+  }
+
+  void publishFromISR(const T& item, BaseType_t& task_woken) {
+    portENTER_CRITICAL_ISR(&_mux);
+    _write(item);
+    portEXIT_CRITICAL_ISR(&_mux);
+
+    uint32_t waiting = _takeWaiting();
+    while (waiting) {
+      const TaskHandle_t task = _subscribers[__builtin_ctz(waiting)].task;
+      waiting &= waiting - 1;
+      if (task == nullptr) continue;
+      vTaskNotifyGiveIndexedFromISR(task, RTOSCPP_NOTIFY_DEFAULT_INDEX, &task_woken);
+    }
+  }
+
+  // Copies the next item of the subscriber without blocking
+  bool tryReceive(const uint8_t id, T& var) {
+    if (id >= MAX_SUBSCRIBERS) return false;
+    _Subscriber& subscriber = _subscribers[id];
+
+    while (true) {
+      const uint32_t head = _head.load(std::memory_order_acquire);
+      if (head == subscriber.cursor) return false;
+
+      // The oldest slot may be in the middle of being overwritten, so a lagging subscriber skips
+      // it as well
+      if (head - subscriber.cursor >= LENGTH) {
+        const uint32_t oldest = head - LENGTH + 1;
+        subscriber.dropped += oldest - subscriber.cursor;
+        subscriber.cursor = oldest;
+      }
+
+      var = _storage[subscriber.cursor & (LENGTH - 1)];
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      // Keep the copy only if the publisher didn't reach the slot meanwhile
+      if (_head.load(std::memory_order_relaxed) - subscriber.cursor < LENGTH) {
+        subscriber.cursor++;
+        return true;
+      }
+    }
+  }
+
+  bool receive(const uint8_t id, T& var, const TickType_t ticks_to_wait = portMAX_DELAY) {
+    if (id >= MAX_SUBSCRIBERS) return false;
+    const uint32_t bit = 1UL << id;
+
+    TimeOut_t timeout;
+    TickType_t remaining = ticks_to_wait;
+    vTaskSetTimeOutState(&timeout);
+
+    while (true) {
+      if (tryReceive(id, var)) return true;
+
+      _waiting.fetch_or(bit, std::memory_order_seq_cst);
+
+      // Check again, an item may have been published before the waiting bit was visible
+      if (tryReceive(id, var)) {
+        _waiting.fetch_and(~bit, std::memory_order_relaxed);
+        return true;
+      }
+
+      if (remaining == 0) break;
+
+      ulTaskNotifyTakeIndexed(RTOSCPP_NOTIFY_DEFAULT_INDEX, pdTRUE, remaining);
+
+      if (xTaskCheckForTimeOut(&timeout, &remaining)) break;
+    }
+
+    _waiting.fetch_and(~bit, std::memory_order_relaxed);
+    return tryReceive(id, var);
+  }
+
+  // Items published but not yet received by the subscriber, including the ones it will lose
+  uint32_t getPending(const uint8_t id) const {
+    if (id >= MAX_SUBSCRIBERS || _subscribers[id].task == nullptr) return 0;
+    return _head.load(std::memory_order_acquire) - _subscribers[id].cursor;
+  }
+
+  // Items the subscriber lost because it lagged behind the publisher
+  uint32_t getDropped(const uint8_t id) const {
+    return id < MAX_SUBSCRIBERS ? _subscribers[id].dropped : 0;
+  }
+
+  uint32_t getPublished() const { return _head.load(std::memory_order_relaxed); }
+
+  uint8_t getSubscribers() const {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+      if (_subscribers[i].task) count++;
+    }
+    return count;
+  }
+
+  static constexpr uint32_t storageBytes() { return LENGTH * sizeof(T); }
+  static constexpr uint32_t controlBlockBytes() {
+    return sizeof(BroadcastChannel) - storageBytes();
+  }
+  static constexpr uint32_t capacityItems() { return LENGTH - 1; }
+
+  private:
+  struct _Subscriber {
+    TaskHandle_t task;
+    uint32_t cursor;
+    uint32_t dropped;
+  };
+
+  // Must be called inside the critical section
+  void _write(const T& item) {
+    const uint32_t head = _head.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _storage[head & (LENGTH - 1)] = item;
+    _head.store(head + 1, std::memory_order_release);
+  }
+
+  uint32_t _takeWaiting() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_waiting.load(std::memory_order_relaxed) == 0) return 0;
+    return _waiting.exchange(0, std::memory_order_acq_rel);
+  }
+
+  std::atomic<uint32_t> _head;
+  std::atomic<uint32_t> _waiting;
+  portMUX_TYPE _mux;
+  _Subscriber _subscribers[MAX_SUBSCRIBERS];
+  T _storage[LENGTH];
+};
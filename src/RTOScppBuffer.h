@@ -6,18 +6,28 @@
 
 #pragma once
 
+#include "RTOScppMemory.h"
+#include "RTOScppTrace.h"
 #include <Arduino.h>
 #include <freertos/message_buffer.h>
 #include <freertos/stream_buffer.h>
+#include <sys/uio.h>
 
 class DataBufferInterface {
   protected:
-  DataBufferInterface(const StreamBufferHandle_t handle)
-      : _handle(handle) {}
+  DataBufferInterface(const StreamBufferHandle_t handle, const bool message = false)
+      : _handle(handle)
+      , _message(message) {}
 
   StreamBufferHandle_t _handle;
+  const bool _message;
 
   public:
+  // Returned by the fragment functions of a message buffer when several fragments are given without
+  // a scratch buffer, or the scratch buffer is too small. It also trips configASSERT, it is a usage
+  // error and never means the buffer is full
+  static constexpr uint32_t FRAGMENTS_ERROR = 0xffffffff;
+
   virtual ~DataBufferInterface() {
     if (_handle) vStreamBufferDelete(_handle);
   }
@@ -29,33 +39,208 @@ class DataBufferInterface {
 
   uint32_t send(const void* tx_buffer, const uint32_t bytes,
                 const TickType_t ticks_to_wait = portMAX_DELAY) const {
-    return xStreamBufferSend(_handle, tx_buffer, bytes, ticks_to_wait);
+    RTOSCPP_TRACE_BEGIN();
+    const uint32_t sent = xStreamBufferSend(_handle, tx_buffer, bytes, ticks_to_wait);
+    RTOSCPP_TRACE_END(this, TraceOp::BufferSend, sent == bytes);
+    return sent;
   }
 
   uint32_t sendFromISR(const void* tx_buffer, const uint32_t bytes, BaseType_t& task_woken) const {
     return xStreamBufferSendFromISR(_handle, tx_buffer, bytes, &task_woken);
   }
 
+  // Writes the fragments back to back without staging them in a temporary buffer. When the whole
+  // chunk already fits it is written at once, otherwise the fragments are written as space frees
+  // up within ticks_to_wait, so a timeout can leave only the first fragments written. Returns the
+  // bytes written, like send().
+  //
+  // A message buffer takes a single fragment here, several fragments must go through the overload
+  // taking a scratch buffer, otherwise FRAGMENTS_ERROR is returned
+  uint32_t sendv(const iovec* const fragments, const uint32_t count,
+                 const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    if (_message && count != 1) return _fragmentsError();
+    if (_message) return send(fragments[0].iov_base, fragments[0].iov_len, ticks_to_wait);
+
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < count; i++) total += fragments[i].iov_len;
+
+    if (xStreamBufferSpacesAvailable(_handle) >= total) {
+      uint32_t sent = 0;
+      for (uint32_t i = 0; i < count; i++) {
+        sent += xStreamBufferSend(_handle, fragments[i].iov_base, fragments[i].iov_len, 0);
+      }
+      return sent;
+    }
+
+    TimeOut_t timeout;
+    TickType_t remaining = ticks_to_wait;
+    vTaskSetTimeOutState(&timeout);
+
+    uint32_t sent = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      const uint32_t bytes = xStreamBufferSend(
+        _handle, fragments[i].iov_base, fragments[i].iov_len, remaining);
+      sent += bytes;
+
+      if (bytes != fragments[i].iov_len || xTaskCheckForTimeOut(&timeout, &remaining)) break;
+    }
+
+    return sent;
+  }
+
+  // Gathers the fragments in scratch and sends them at once, as a single message on a message
+  // buffer. Returns FRAGMENTS_ERROR if they don't fit in scratch
+  uint32_t sendv(const iovec* const fragments, const uint32_t count, uint8_t* const scratch,
+                 const uint32_t scratch_size,
+                 const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    const uint32_t total = _gather(fragments, count, scratch, scratch_size);
+    return total != FRAGMENTS_ERROR ? send(scratch, total, ticks_to_wait) : total;
+  }
+
+  // All or nothing, a message buffer takes a single fragment as in sendv()
+  uint32_t sendvFromISR(const iovec* const fragments, const uint32_t count,
+                        BaseType_t& task_woken) const {
+    if (_message && count != 1) return _fragmentsError();
+    if (_message) return sendFromISR(fragments[0].iov_base, fragments[0].iov_len, task_woken);
+
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < count; i++) total += fragments[i].iov_len;
+    if (xStreamBufferSpacesAvailable(_handle) < total) return 0;
+
+    uint32_t sent = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      sent += xStreamBufferSendFromISR(
+        _handle, fragments[i].iov_base, fragments[i].iov_len, &task_woken);
+    }
+    return sent;
+  }
+
+  uint32_t sendvFromISR(const iovec* const fragments, const uint32_t count, uint8_t* const scratch,
+                        const uint32_t scratch_size, BaseType_t& task_woken) const {
+    const uint32_t total = _gather(fragments, count, scratch, scratch_size);
+    return total != FRAGMENTS_ERROR ? sendFromISR(scratch, total, task_woken) : total;
+  }
+
   uint32_t receive(void* rx_buffer, const uint32_t bytes,
                    const TickType_t ticks_to_wait = portMAX_DELAY) const {
-    return xStreamBufferReceive(_handle, rx_buffer, bytes, ticks_to_wait);
+    RTOSCPP_TRACE_BEGIN();
+    const uint32_t received = xStreamBufferReceive(_handle, rx_buffer, bytes, ticks_to_wait);
+    RTOSCPP_TRACE_END(this, TraceOp::BufferReceive, received != 0);
+    return received;
   }
 
   uint32_t receiveFromISR(void* rx_buffer, const uint32_t bytes, BaseType_t& task_woken) const {
     return xStreamBufferReceiveFromISR(_handle, rx_buffer, bytes, &task_woken);
   }
 
+  // Fills the fragments in order. Only the first read blocks, the rest take what is already
+  // available. Returns the total bytes received.
+  //
+  // A message buffer takes a single fragment here, several fragments must go through the overload
+  // taking a scratch buffer, otherwise FRAGMENTS_ERROR is returned
+  uint32_t receiveInto(const iovec* const fragments, const uint32_t count,
+                       const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    if (_message && count != 1) return _fragmentsError();
+    if (_message) return receive(fragments[0].iov_base, fragments[0].iov_len, ticks_to_wait);
+
+    uint32_t received = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+      const uint32_t bytes = xStreamBufferReceive(
+        _handle, fragments[i].iov_base, fragments[i].iov_len, i == 0 ? ticks_to_wait : 0);
+      received += bytes;
+
+      if (bytes != fragments[i].iov_len) break;
+    }
+
+    return received;
+  }
+
+  // Receives a single message in scratch and spreads it over the fragments. Returns
+  // FRAGMENTS_ERROR if scratch can't hold what the fragments can. As with receive(), a message
+  // larger than the fragments is left in the buffer and 0 is returned
+  uint32_t receiveInto(const iovec* const fragments, const uint32_t count, uint8_t* const scratch,
+                       const uint32_t scratch_size,
+                       const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < count; i++) total += fragments[i].iov_len;
+    if (total > scratch_size) return _fragmentsError();
+
+    const uint32_t received = receive(scratch, total, ticks_to_wait);
+
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < count && offset < received; i++) {
+      const uint32_t bytes = min((uint32_t)fragments[i].iov_len, received - offset);
+      memcpy(fragments[i].iov_base, scratch + offset, bytes);
+      offset += bytes;
+    }
+
+    return received;
+  }
+
+  // Waits up to ticks_to_wait for the trigger level, then keeps collecting until rx_buffer is full
+  // or batch_ticks have elapsed since the first chunk arrived, so the consumer wakes once per batch
+  // instead of once per trigger. Message buffers return a single message as receive() does
+  uint32_t receiveBatch(void* rx_buffer, const uint32_t bytes, const TickType_t batch_ticks,
+                        const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    uint32_t received = receive(rx_buffer, bytes, ticks_to_wait);
+    if (_message || received == 0 || batch_ticks == 0) return received;
+
+    TimeOut_t timeout;
+    TickType_t remaining = batch_ticks;
+    vTaskSetTimeOutState(&timeout);
+
+    while (received < bytes && !xTaskCheckForTimeOut(&timeout, &remaining)) {
+      received += xStreamBufferReceive(
+        _handle, static_cast<uint8_t*>(rx_buffer) + received, bytes - received, remaining);
+    }
+
+    return received;
+  }
+
+  // Length of the next message in a message buffer, 0 if there is none
+  uint32_t nextMessageLength() const {
+    return _message ? xStreamBufferNextMessageLengthBytes(_handle) : 0;
+  }
+
+  bool isMessageBuffer() const { return _message; }
+
   bool reset() const { return xStreamBufferReset(_handle); }
   bool isEmpty() const { return xStreamBufferIsEmpty(_handle); }
   bool isFull() const { return xStreamBufferIsFull(_handle); }
+  // On a message buffer the next message also needs sizeof(size_t) bytes of these for its length
   uint32_t availableSpaces() const { return xStreamBufferSpacesAvailable(_handle); }
   uint32_t availableBytes() const { return xStreamBufferBytesAvailable(_handle); }
 
+  StreamBufferHandle_t getHandle() const { return _handle; }
+
   bool setTriggerLevel(const uint32_t trigger_bytes) {
     return xStreamBufferSetTriggerLevel(_handle, trigger_bytes);
   }
 
   explicit operator bool() const { return _handle != nullptr; }
+
+  private:
+  static uint32_t _fragmentsError() {
+    configASSERT(false);
+    return FRAGMENTS_ERROR;
+  }
+
+  // Copies the fragments back to back into staging, returns FRAGMENTS_ERROR if they don't fit
+  static uint32_t _gather(const iovec* const fragments, const uint32_t count,
+                          uint8_t* const staging, const uint32_t staging_size) {
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < count; i++) total += fragments[i].iov_len;
+    if (total > staging_size) return _fragmentsError();
+
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      memcpy(staging + offset, fragments[i].iov_base, fragments[i].iov_len);
+      offset += fragments[i].iov_len;
+    }
+
+    return total;
+  }
 };
 
 class StreamBufferDynamic : public DataBufferInterface {
@@ -67,6 +252,16 @@ class StreamBufferDynamic : public DataBufferInterface {
 template <uint32_t BUFFER_SIZE>
 class StreamBufferStatic : public DataBufferInterface {
   public:
+  static constexpr uint32_t storageBytes() { return BUFFER_SIZE + 1; }
+  static constexpr uint32_t controlBlockBytes() {
+    return sizeof(StreamBufferStatic) - storageBytes();
+  }
+
+  // Chunks of avg_size bytes that fit at once
+  static constexpr uint32_t capacityItems(const uint32_t avg_size = 1) {
+    return avg_size ? BUFFER_SIZE / avg_size : 0;
+  }
+
   StreamBufferStatic(const uint32_t trigger_bytes)
       : DataBufferInterface(xStreamBufferGenericCreateStatic(BUFFER_SIZE + 1, trigger_bytes, false,
                                                              _storage, &_tcb)) {}
@@ -76,43 +271,143 @@ class StreamBufferStatic : public DataBufferInterface {
   uint8_t _storage[BUFFER_SIZE + 1];
 };
 
+// Like StreamBufferStatic, with the storage placed according to MEMORY (see RTOScppMemory.h). The
+// control block is allocated from the internal heap on construction, it is not part of the object.
+// Evaluates to false if either allocation failed
+template <uint32_t BUFFER_SIZE, typename MEMORY = MemoryInternal>
+class StreamBufferPlaced : public DataBufferInterface {
+  public:
+  static constexpr uint32_t storageBytes() { return BUFFER_SIZE + 1; }
+  static constexpr uint32_t controlBlockBytes() {
+    return sizeof(StreamBufferPlaced) + sizeof(StaticStreamBuffer_t);
+  }
+
+  // Chunks of avg_size bytes that fit at once
+  static constexpr uint32_t capacityItems(const uint32_t avg_size = 1) {
+    return avg_size ? BUFFER_SIZE / avg_size : 0;
+  }
+
+  StreamBufferPlaced(const uint32_t trigger_bytes)
+      : DataBufferInterface(nullptr)
+      , _tcb(sizeof(StaticStreamBuffer_t))
+      , _storage(BUFFER_SIZE + 1) {
+    if (!_tcb || !_storage) return;
+    _handle = xStreamBufferGenericCreateStatic(BUFFER_SIZE + 1, trigger_bytes, false,
+                                               _storage.template as<uint8_t>(),
+                                               _tcb.template as<StaticStreamBuffer_t>());
+  }
+
+  // The buffer must be deleted before its memory is released
+  ~StreamBufferPlaced() {
+    if (_handle) vStreamBufferDelete(_handle);
+    _handle = nullptr;
+  }
+
+  private:
+  _ControlBlock _tcb;
+  _MemoryBlock<MEMORY::CAPS> _storage;
+};
+
 class StreamBufferExternalStorage : public DataBufferInterface {
   public:
   StreamBufferExternalStorage(const uint32_t trigger_bytes)
-      : DataBufferInterface(nullptr) {}
+      : DataBufferInterface(nullptr)
+      , _trigger_bytes(trigger_bytes) {}
+
+  // The buffer must be buffer_size + 1 bytes long. Uses the trigger level given on construction
+  bool init(uint8_t* const buffer, const uint32_t buffer_size) {
+    return init(_trigger_bytes, buffer, buffer_size);
+  }
 
   bool init(const uint32_t trigger_bytes, uint8_t* const buffer, const uint32_t buffer_size) {
+    _trigger_bytes = trigger_bytes;
     _handle =
       xStreamBufferGenericCreateStatic(buffer_size + 1, trigger_bytes, pdFALSE, buffer, &_tcb);
     return _handle != nullptr ? true : false;
   }
 
   private:
+  uint32_t _trigger_bytes;
   StaticStreamBuffer_t _tcb;
 };
 
+// Every message is stored after a sizeof(size_t) length header (4 bytes on the ESP32), taken from
+// the buffer size like its payload. A buffer of N bytes holds less than N bytes of messages, see
+// capacityItems()
 class MessageBufferDynamic : public DataBufferInterface {
   public:
   MessageBufferDynamic(const uint32_t buffer_size)
-      : DataBufferInterface(xStreamBufferGenericCreate(buffer_size + 1, 0, false)) {}
+      : DataBufferInterface(xStreamBufferGenericCreate(buffer_size + 1, 0, true), true) {}
 };
 
 template <uint32_t BUFFER_SIZE>
 class MessageBufferStatic : public DataBufferInterface {
   public:
+  static constexpr uint32_t storageBytes() { return BUFFER_SIZE + 1; }
+  static constexpr uint32_t controlBlockBytes() {
+    return sizeof(MessageBufferStatic) - storageBytes();
+  }
+
+  // Messages of avg_size bytes that fit at once, each one is stored after a size_t length
+  static constexpr uint32_t capacityItems(const uint32_t avg_size = 1) {
+    return BUFFER_SIZE / (avg_size + sizeof(size_t));
+  }
+
   MessageBufferStatic()
       : DataBufferInterface(
-          xStreamBufferGenericCreateStatic(BUFFER_SIZE + 1, 0, false, _storage, &_tcb)) {}
+          xStreamBufferGenericCreateStatic(BUFFER_SIZE + 1, 0, true, _storage, &_tcb), true) {}
 
   private:
   StaticStreamBuffer_t _tcb;
   uint8_t _storage[BUFFER_SIZE + 1];
 };
 
+// Like MessageBufferStatic, with the storage placed according to MEMORY (see RTOScppMemory.h). The
+// control block is allocated from the internal heap on construction, it is not part of the object.
+// Evaluates to false if either allocation failed
+template <uint32_t BUFFER_SIZE, typename MEMORY = MemoryInternal>
+class MessageBufferPlaced : public DataBufferInterface {
+  public:
+  static constexpr uint32_t storageBytes() { return BUFFER_SIZE + 1; }
+  static constexpr uint32_t controlBlockBytes() {
+    return sizeof(MessageBufferPlaced) + sizeof(StaticStreamBuffer_t);
+  }
+
+  // Messages of avg_size bytes that fit at once, each one is stored after a size_t length
+  static constexpr uint32_t capacityItems(const uint32_t avg_size = 1) {
+    return BUFFER_SIZE / (avg_size + sizeof(size_t));
+  }
+
+  MessageBufferPlaced()
+      : DataBufferInterface(nullptr, true)
+      , _tcb(sizeof(StaticStreamBuffer_t))
+      , _storage(BUFFER_SIZE + 1) {
+    if (!_tcb || !_storage) return;
+    _handle = xStreamBufferGenericCreateStatic(BUFFER_SIZE + 1, 0, true,
+                                               _storage.template as<uint8_t>(),
+                                               _tcb.template as<StaticStreamBuffer_t>());
+  }
+
+  // The buffer must be deleted before its memory is released
+  ~MessageBufferPlaced() {
+    if (_handle) vStreamBufferDelete(_handle);
+    _handle = nullptr;
+  }
+
+  private:
+  _ControlBlock _tcb;
+  _MemoryBlock<MEMORY::CAPS> _storage;
+};
+
 class MessageBufferExternalStorage : public DataBufferInterface {
   public:
   MessageBufferExternalStorage()
-      : DataBufferInterface(nullptr) {}
+      : DataBufferInterface(nullptr, true) {}
+
+  // Message buffers don't use a trigger level, trigger_bytes is kept for compatibility
+  bool init(uint8_t* const buffer, const uint32_t buffer_size) {
+    return init(0, buffer, buffer_size);
+  }
 
   bool init(const uint32_t trigger_bytes, uint8_t* const buffer, const uint32_t buffer_size) {
     _handle = xStreamBufferGenericCreateStatic(buffer_size + 1, 0, true, buffer, &_tcb);
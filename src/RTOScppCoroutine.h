@@ -0,0 +1,411 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+// Needs C++20 coroutines, the header is empty otherwise
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+
+#include "RTOScppLock.h"
+#include "RTOScppMemory.h"
+#include "RTOScppNotify.h"
+#include "RTOScppQueue.h"
+#include <Arduino.h>
+#include <atomic>
+#include <coroutine>
+#include <esp_heap_caps.h>
+
+// heap_caps_malloc() capabilities of the coroutine frames
+#ifndef RTOSCPP_COROUTINE_CAPS
+#define RTOSCPP_COROUTINE_CAPS MemoryInternal::CAPS
+#endif
+
+class _CoSchedulerBase;
+
+// Suspension point of a coroutine. A polled waiter retries its operation without blocking when the
+// scheduler polls, the others only complete when their slot is signalled or the timeout expires
+class _CoWaiter {
+  public:
+  virtual bool poll() = 0;
+
+  protected:
+  ~_CoWaiter() = default;
+
+  friend class _CoSchedulerBase;
+
+  TimeOut_t _timeout;
+  TickType_t _remaining;
+  bool _result;
+  bool _polled;
+};
+
+// Return type of the coroutines run by a CoScheduler. The frame is allocated from
+// RTOSCPP_COROUTINE_CAPS when the coroutine is called and released by the scheduler when it
+// returns. If the allocation fails the CoTask is empty and spawn() refuses it
+class CoTask {
+  public:
+  struct promise_type {
+    _CoSchedulerBase* scheduler = nullptr;
+    _CoWaiter* waiter           = nullptr;
+    uint8_t slot                = 0;
+
+    static void* operator new(const size_t bytes) noexcept {
+      return heap_caps_malloc(bytes, RTOSCPP_COROUTINE_CAPS);
+    }
+
+    static void operator delete(void* const frame) noexcept { heap_caps_free(frame); }
+
+    static CoTask get_return_object_on_allocation_failure() { return CoTask(nullptr); }
+
+    CoTask get_return_object() { return CoTask(Handle::from_promise(*this)); }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { abort(); }
+  };
+
+  typedef std::coroutine_handle<promise_type> Handle;
+
+  ~CoTask() {
+    if (_handle) _handle.destroy();
+  }
+
+  CoTask(const CoTask&)            = delete;
+  CoTask& operator=(const CoTask&) = delete;
+
+  CoTask(CoTask&& other) noexcept
+      : _handle(other._handle) {
+    other._handle = nullptr;
+  }
+
+  CoTask& operator=(CoTask&&) noexcept = delete;
+
+  explicit operator bool() const { return static_cast<bool>(_handle); }
+
+  private:
+  friend class _CoSchedulerBase;
+
+  explicit CoTask(const Handle handle)
+      : _handle(handle) {}
+
+  Handle _handle;
+};
+
+// Awaitable that tries OPERATION right away, then suspends the coroutine until the scheduler sees
+// it succeed or ticks_to_wait expire. co_await returns whether the operation succeeded
+template <typename OPERATION>
+class _CoAwaiter : public _CoWaiter {
+  public:
+  _CoAwaiter(const OPERATION& operation, const TickType_t ticks_to_wait, const bool polled)
+      : _operation(operation) {
+    _remaining = ticks_to_wait;
+    _result    = false;
+    _polled    = polled;
+  }
+
+  bool await_ready() {
+    _result = _operation();
+    return _result || _remaining == 0;
+  }
+
+  void await_suspend(const CoTask::Handle handle) {
+    vTaskSetTimeOutState(&_timeout);
+    handle.promise().waiter = this;
+  }
+
+  bool await_resume() const { return _result; }
+
+  bool poll() override { return _operation(); }
+
+  private:
+  OPERATION _operation;
+};
+
+template <typename OPERATION>
+_CoAwaiter<OPERATION> _coAwait(const OPERATION& operation, const TickType_t ticks_to_wait,
+                               const bool polled = true) {
+  return _CoAwaiter<OPERATION>(operation, ticks_to_wait, polled);
+}
+
+// Runs many coroutines on the stack of a single task. Coroutines waiting on a kernel object are
+// polled every poll_ticks, or sooner when wake() is called (e.g. by the producer after a send).
+// Coroutines waiting on a CoEvent or a delay are never polled, they are resumed when the event is
+// set or the deadline passes. spawn() must be called before run() or from a coroutine of the same
+// scheduler
+class _CoSchedulerBase {
+  protected:
+  _CoSchedulerBase(CoTask::Handle* const slots, const uint8_t capacity,
+                   const TickType_t poll_ticks)
+      : _slots(slots)
+      , _capacity(capacity)
+      , _poll_ticks(poll_ticks ? poll_ticks : 1)
+      , _count(0)
+      , _task(nullptr)
+      , _last_poll(0)
+      , _signalled(0) {}
+
+  public:
+  virtual ~_CoSchedulerBase() {
+    for (uint8_t i = 0; i < _capacity; i++) {
+      if (_slots[i]) _slots[i].destroy();
+    }
+  }
+
+  _CoSchedulerBase(const _CoSchedulerBase&)                = delete;
+  _CoSchedulerBase& operator=(const _CoSchedulerBase&)     = delete;
+  _CoSchedulerBase(_CoSchedulerBase&&) noexcept            = delete;
+  _CoSchedulerBase& operator=(_CoSchedulerBase&&) noexcept = delete;
+
+  // Takes ownership of the coroutine. Returns false if all the slots are in use
+  bool spawn(CoTask&& task) {
+    if (!task) return false;
+
+    for (uint8_t i = 0; i < _capacity; i++) {
+      if (_slots[i]) continue;
+
+      _slots[i]                     = task._handle;
+      _slots[i].promise().scheduler = this;
+      _slots[i].promise().slot      = i;
+      task._handle                  = nullptr;
+      _count++;
+      _notify();
+      return true;
+    }
+
+    return false;
+  }
+
+  // Resumes every coroutine that can make progress. Returns the ticks the caller may sleep
+  TickType_t step() {
+    const TickType_t now     = xTaskGetTickCount();
+    const uint32_t signalled = _signalled.exchange(0, std::memory_order_acq_rel);
+    const bool periodic      = now - _last_poll >= _poll_ticks;
+    if (periodic) _last_poll = now;
+
+    const TickType_t next_poll = _poll_ticks - (now - _last_poll);
+    TickType_t idle            = portMAX_DELAY;
+
+    for (uint8_t i = 0; i < _capacity; i++) {
+      const CoTask::Handle handle = _slots[i];
+      if (!handle) continue;
+
+      CoTask::promise_type& promise = handle.promise();
+
+      if (promise.waiter) {
+        _CoWaiter& waiter = *promise.waiter;
+        const bool poll   = ((signalled >> i) & 1) || (periodic && waiter._polled);
+
+        if (poll && waiter.poll()) {
+          waiter._result = true;
+        } else if (!xTaskCheckForTimeOut(&waiter._timeout, &waiter._remaining)) {
+          idle = min(idle, _wakeIn(waiter, next_poll));
+          continue;
+        }
+
+        promise.waiter = nullptr;
+      }
+
+      handle.resume();
+
+      if (handle.done()) {
+        handle.destroy();
+        _slots[i] = nullptr;
+        _count--;
+      } else if (promise.waiter) {
+        idle = min(idle, _wakeIn(*promise.waiter, next_poll));
+      } else {
+        idle = 0;
+      }
+    }
+
+    return idle;
+  }
+
+  // Runs the coroutines forever on the calling task
+  void run() {
+    _task = xTaskGetCurrentTaskHandle();
+
+    while (true) {
+      const TickType_t idle = step();
+      if (idle == 0) continue;
+      ulTaskNotifyTakeIndexed(RTOSCPP_NOTIFY_DEFAULT_INDEX, pdTRUE, idle);
+    }
+  }
+
+  // Makes the scheduler poll its waiting coroutines now instead of after poll_ticks
+  void wake() const {
+    _signalled.store(0xffffffff, std::memory_order_release);
+    _notify();
+  }
+
+  void wakeFromISR(BaseType_t& task_woken) const {
+    _signalled.store(0xffffffff, std::memory_order_release);
+    _notifyFromISR(task_woken);
+  }
+
+  uint8_t getCount() const { return _count; }
+  TickType_t getPollTicks() const { return _poll_ticks; }
+
+  private:
+  friend class CoEvent;
+
+  // Ticks until the waiter needs the scheduler again: its timeout, or the next poll if polled
+  static TickType_t _wakeIn(const _CoWaiter& waiter, const TickType_t next_poll) {
+    return waiter._polled ? min(waiter._remaining, next_poll) : waiter._remaining;
+  }
+
+  // Polls only the coroutine of the given slot on the next step
+  void _signal(const uint8_t slot) const {
+    _signalled.fetch_or(1u << slot, std::memory_order_acq_rel);
+    _notify();
+  }
+
+  void _signalFromISR(const uint8_t slot, BaseType_t& task_woken) const {
+    _signalled.fetch_or(1u << slot, std::memory_order_acq_rel);
+    _notifyFromISR(task_woken);
+  }
+
+  void _notify() const {
+    if (_task == nullptr) return;
+    xTaskNotifyGiveIndexed(_task, RTOSCPP_NOTIFY_DEFAULT_INDEX);
+  }
+
+  void _notifyFromISR(BaseType_t& task_woken) const {
+    if (_task == nullptr) return;
+    vTaskNotifyGiveIndexedFromISR(_task, RTOSCPP_NOTIFY_DEFAULT_INDEX, &task_woken);
+  }
+
+  CoTask::Handle* const _slots;
+  const uint8_t _capacity;
+  const TickType_t _poll_ticks;
+  uint8_t _count;
+  TaskHandle_t _task;
+  TickType_t _last_poll;
+  mutable std::atomic<uint32_t> _signalled; // One bit per slot
+};
+
+template <uint8_t MAX_COROUTINES>
+class CoScheduler : public _CoSchedulerBase {
+  static_assert(MAX_COROUTINES > 0 && MAX_COROUTINES <= 32,
+                "MAX_COROUTINES must be between 1 and 32");
+
+  public:
+  CoScheduler(const TickType_t poll_ticks = 1)
+      : _CoSchedulerBase(_storage, MAX_COROUTINES, poll_ticks)
+      , _storage{} {}
+
+  private:
+  CoTask::Handle _storage[MAX_COROUTINES];
+};
+
+// Binary event a coroutine can wait on, set from tasks or ISRs. Setting it resumes only the
+// coroutine waiting on it, a single coroutine may wait at a time
+class CoEvent {
+  public:
+  CoEvent(const _CoSchedulerBase& scheduler)
+      : _scheduler(scheduler)
+      , _set(false)
+      , _waiter(0) {}
+
+  CoEvent(const CoEvent&)                = delete;
+  CoEvent& operator=(const CoEvent&)     = delete;
+  CoEvent(CoEvent&&) noexcept            = delete;
+  CoEvent& operator=(CoEvent&&) noexcept = delete;
+
+  void set() {
+    _set.store(true);
+    const uint8_t waiter = _waiter.load();
+    if (waiter) _scheduler._signal(waiter - 1);
+  }
+
+  void setFromISR(BaseType_t& task_woken) {
+    _set.store(true);
+    const uint8_t waiter = _waiter.load();
+    if (waiter) _scheduler._signalFromISR(waiter - 1, task_woken);
+  }
+
+  // Consumes the event if it is set
+  bool tryWait() { return _set.exchange(false, std::memory_order_acq_rel); }
+
+  private:
+  friend class _CoEventAwaiter;
+
+  // Both sides store before they load, so either set() sees the waiter or _arm() sees the event
+  void _arm(const uint8_t slot) {
+    _waiter.store(slot + 1);
+    if (_set.load()) _scheduler._signal(slot);
+  }
+
+  void _disarm() { _waiter.store(0); }
+
+  const _CoSchedulerBase& _scheduler;
+  std::atomic<bool> _set;
+  std::atomic<uint8_t> _waiter; // Slot + 1 of the waiting coroutine, 0 for none
+};
+
+class _CoEventAwaiter : public _CoWaiter {
+  public:
+  _CoEventAwaiter(CoEvent& event, const TickType_t ticks_to_wait)
+      : _event(event) {
+    _remaining = ticks_to_wait;
+    _result    = false;
+    _polled    = false;
+  }
+
+  bool await_ready() {
+    _result = _event.tryWait();
+    return _result || _remaining == 0;
+  }
+
+  void await_suspend(const CoTask::Handle handle) {
+    vTaskSetTimeOutState(&_timeout);
+    handle.promise().waiter = this;
+    _event._arm(handle.promise().slot);
+  }
+
+  bool await_resume() {
+    _event._disarm();
+    return _result;
+  }
+
+  bool poll() override { return _event.tryWait(); }
+
+  private:
+  CoEvent& _event;
+};
+
+// Awaitables, to be used with co_await inside a CoTask
+
+template <typename T>
+auto popAsync(const _QueueBase<T>& queue, T& var, const TickType_t ticks_to_wait = portMAX_DELAY) {
+  return _coAwait([&queue, &var]() { return queue.pop(var, 0); }, ticks_to_wait);
+}
+
+template <typename T>
+auto addAsync(const _QueueBase<T>& queue, const T& item,
+              const TickType_t ticks_to_wait = portMAX_DELAY) {
+  return _coAwait([&queue, &item]() { return queue.add(item, 0); }, ticks_to_wait);
+}
+
+// Meant for semaphores. A mutex taken this way is owned by the scheduler task
+inline auto takeAsync(const LockInterface& lock, const TickType_t ticks_to_wait = portMAX_DELAY) {
+  return _coAwait([&lock]() { return lock.take(0); }, ticks_to_wait);
+}
+
+inline _CoEventAwaiter waitAsync(CoEvent& event, const TickType_t ticks_to_wait = portMAX_DELAY) {
+  return _CoEventAwaiter(event, ticks_to_wait);
+}
+
+inline auto delayAsync(const TickType_t ticks) {
+  return _coAwait([]() { return false; }, ticks, false);
+}
+
+// Lets the other coroutines run before continuing
+inline std::suspend_always yieldAsync() { return {}; }
+
+#endif
+#endif
@@ -0,0 +1,86 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/event_groups.h>
+
+class EventGroupInterface {
+  protected:
+  EventGroupInterface(const EventGroupHandle_t handle)
+      : _handle(handle) {}
+
+  EventGroupHandle_t _handle;
+
+  public:
+  virtual ~EventGroupInterface() {
+    if (_handle) vEventGroupDelete(_handle);
+  }
+
+  EventGroupInterface(const EventGroupInterface&)                = delete;
+  EventGroupInterface& operator=(const EventGroupInterface&)     = delete;
+  EventGroupInterface(EventGroupInterface&&) noexcept            = delete;
+  EventGroupInterface& operator=(EventGroupInterface&&) noexcept = delete;
+
+  EventGroupHandle_t getHandle() const { return _handle; }
+
+  // Returns the bits at the time the call returns
+  EventBits_t set(const EventBits_t bits) const { return xEventGroupSetBits(_handle, bits); }
+
+  // Returns the bits before clearing
+  EventBits_t clear(const EventBits_t bits) const { return xEventGroupClearBits(_handle, bits); }
+
+  EventBits_t get() const { return xEventGroupGetBits(_handle); }
+  EventBits_t getFromISR() const { return xEventGroupGetBitsFromISR(_handle); }
+
+  // The bits are set from the timer daemon task, so this fails if its queue is full
+  bool setFromISR(const EventBits_t bits, BaseType_t& task_woken) const {
+    return xEventGroupSetBitsFromISR(_handle, bits, &task_woken);
+  }
+
+  bool clearFromISR(const EventBits_t bits) const {
+    return xEventGroupClearBitsFromISR(_handle, bits);
+  }
+
+  // Waits until any of the bits is set. Returns the bits at the time the wait ended, check them to
+  // know if it timed out
+  EventBits_t waitAny(const EventBits_t bits, const bool clear_on_exit = true,
+                      const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    return xEventGroupWaitBits(_handle, bits, clear_on_exit, pdFALSE, ticks_to_wait);
+  }
+
+  EventBits_t waitAll(const EventBits_t bits, const bool clear_on_exit = true,
+                      const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    return xEventGroupWaitBits(_handle, bits, clear_on_exit, pdTRUE, ticks_to_wait);
+  }
+
+  // Sets bits_to_set and waits until every bit of bits_to_wait is set, as a rendezvous point
+  EventBits_t sync(const EventBits_t bits_to_set, const EventBits_t bits_to_wait,
+                   const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    return xEventGroupSync(_handle, bits_to_set, bits_to_wait, ticks_to_wait);
+  }
+
+  explicit operator bool() const { return _handle != nullptr; }
+};
+
+class EventGroupDynamic : public EventGroupInterface {
+  public:
+  EventGroupDynamic()
+      : EventGroupInterface(xEventGroupCreate()) {}
+};
+
+class EventGroupStatic : public EventGroupInterface {
+  public:
+  static constexpr uint32_t storageBytes() { return 0; }
+  static constexpr uint32_t controlBlockBytes() { return sizeof(EventGroupStatic); }
+
+  EventGroupStatic()
+      : EventGroupInterface(xEventGroupCreateStatic(&_tcb)) {}
+
+  private:
+  StaticEventGroup_t _tcb;
+};
@@ -0,0 +1,331 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "RTOScppBuffer.h"
+#include "RTOScppLock.h"
+#include "RTOScppPeriodicTask.h"
+#include "RTOScppQueue.h"
+#include <Arduino.h>
+#include <atomic>
+#include <esp_task_wdt.h>
+
+// The value given to the callback is the ticks since the last check-in for TaskStarved, the percent
+// for StackHigh and LevelHigh and the samples the lock has been held for LockHeld
+enum class HealthEvent : uint8_t {
+  TaskStarved, // A watched task didn't check in within its deadline
+  StackHigh,   // The stack high-water mark of a registered task reached the threshold
+  LevelHigh,   // A queue or buffer stayed above its threshold
+  LockHeld,    // A lock stayed unavailable
+};
+
+// Low priority periodic task that samples the health of the application without allocating:
+//
+// - Every task of the registry for stack usage, see setStackThreshold(). TaskInterface::forEach()
+//   pins each task while it is sampled, so tasks can be destroyed while the monitor runs
+// - Up to MAX_TASKS watched tasks that must call checkIn() within their deadline
+// - Up to MAX_RESOURCES queues, buffers and locks for fill level, with high-water marks
+//
+// Events are reported once to the callback, from the monitor task, and rearmed when the condition
+// clears. When the watchdog is enabled the monitor subscribes itself to the ESP task watchdog and
+// feeds it only while no watched task is starved, so a stuck task ends up triggering it.
+//
+// A watched object must outlive its watch: destroy it only after unwatchTask() or unwatchResource()
+// returned, or after the monitor is gone. Both wait for a sample in progress to finish, and the
+// callback may call them
+template <uint32_t STACK_SIZE, uint8_t MAX_TASKS, uint8_t MAX_RESOURCES>
+class HealthMonitor : public PeriodicTask<STACK_SIZE> {
+  static_assert(MAX_TASKS <= 127, "MAX_TASKS must fit the int8_t ids");
+  static_assert(MAX_RESOURCES <= 127, "MAX_RESOURCES must fit the int8_t ids");
+
+  public:
+  typedef void (*Callback_t)(HealthEvent event, const char* name, uint32_t value, void* arg);
+
+  HealthMonitor(const TickType_t period, const uint8_t priority = 1,
+                const BaseType_t running_core = ARDUINO_RUNNING_CORE)
+      : PeriodicTask<STACK_SIZE>("health_monitor", &HealthMonitor::_sample, this, period, priority,
+                                 running_core)
+      , _callback(nullptr)
+      , _callback_arg(nullptr)
+      , _stack_threshold(90)
+      , _watchdog(false)
+      , _watchdog_subscribed(false)
+      , _task_count(0)
+      , _resource_count(0)
+      , _samples(0) {}
+
+  // The monitor task is deleted before it leaves the watchdog, so it can't subscribe or feed it
+  // again in between
+  ~HealthMonitor() {
+    const TaskHandle_t handle = this->_handle;
+    if (handle == nullptr) return;
+
+    vTaskDelete(handle);
+    this->_handle = nullptr;
+
+    if (_watchdog_subscribed) esp_task_wdt_delete(handle);
+  }
+
+  void setCallback(const Callback_t callback, void* arg = nullptr) {
+    _callback     = callback;
+    _callback_arg = arg;
+  }
+
+  // Stack usage in percent that raises StackHigh, 0 disables the check
+  void setStackThreshold(const uint8_t percent) { _stack_threshold = percent; }
+  uint8_t getStackThreshold() const { return _stack_threshold; }
+
+  // The ESP task watchdog must be initialized, as the Arduino core does by default
+  void enableWatchdog(const bool enable = true) { _watchdog = enable; }
+  bool isWatchdogSubscribed() const { return _watchdog_subscribed; }
+
+  // Watchers return their id, or -1 if there is no slot left
+  int8_t watch(TaskInterface& task, const TickType_t deadline) {
+    LockGuardCRTP<MutexRecursiveStaticCRTP> guard(_lock);
+
+    uint8_t id = 0;
+    while (id < _task_count && _tasks[id].task != nullptr) id++;
+    if (id >= MAX_TASKS) return -1;
+    if (id == _task_count) _task_count++;
+
+    _Task& entry   = _tasks[id];
+    entry.task     = &task;
+    entry.deadline = deadline;
+    entry.starved  = false;
+    entry.check_in.store(xTaskGetTickCount(), std::memory_order_relaxed);
+    return id;
+  }
+
+  // threshold is the fill percent, hold_samples the consecutive samples above it before LevelHigh
+  int8_t watch(const QueueInterface& queue, const char* name, const uint8_t threshold = 80,
+               const uint8_t hold_samples = 1) {
+    return _watch(&queue, name, &HealthMonitor::_queueLevel, threshold, hold_samples,
+                  HealthEvent::LevelHigh);
+  }
+
+  int8_t watch(const DataBufferInterface& buffer, const char* name, const uint8_t threshold = 80,
+               const uint8_t hold_samples = 1) {
+    return _watch(&buffer, name, &HealthMonitor::_bufferLevel, threshold, hold_samples,
+                  HealthEvent::LevelHigh);
+  }
+
+  // A lock counts as 100% while it can't be taken
+  int8_t watch(const LockInterface& lock, const char* name, const uint8_t hold_samples) {
+    return _watch(lock.getHandle(), name, &HealthMonitor::_lockLevel, 100, hold_samples,
+                  HealthEvent::LockHeld);
+  }
+
+  template <typename Derived>
+  int8_t watch(const LockCRTP<Derived>& lock, const char* name, const uint8_t hold_samples) {
+    return _watch(lock.getHandle(), name, &HealthMonitor::_lockLevel, 100, hold_samples,
+                  HealthEvent::LockHeld);
+  }
+
+  // The id is free again once these return
+  void unwatchTask(const uint8_t id) {
+    LockGuardCRTP<MutexRecursiveStaticCRTP> guard(_lock);
+    if (id >= _task_count) return;
+
+    _tasks[id].task    = nullptr;
+    _tasks[id].starved = false;
+  }
+
+  void unwatchResource(const uint8_t id) {
+    LockGuardCRTP<MutexRecursiveStaticCRTP> guard(_lock);
+    if (id < _resource_count) _resources[id].object = nullptr;
+  }
+
+  // Called by a watched task to tell it is making progress
+  void checkIn() {
+    const TaskHandle_t current = xTaskGetCurrentTaskHandle();
+    LockGuardCRTP<MutexRecursiveStaticCRTP> guard(_lock);
+
+    for (uint8_t i = 0; i < _task_count; i++) {
+      if (_tasks[i].task == nullptr || _tasks[i].task->getHandle() != current) continue;
+      _tasks[i].check_in.store(xTaskGetTickCount(), std::memory_order_relaxed);
+      return;
+    }
+  }
+
+  bool isStarved(const uint8_t id) const { return id < _task_count && _tasks[id].starved; }
+
+  // Fill level in percent of a watched queue, buffer or lock at the last sample
+  uint8_t getLevel(const uint8_t id) const {
+    return id < _resource_count ? _resources[id].level : 0;
+  }
+
+  uint8_t getMaxLevel(const uint8_t id) const {
+    return id < _resource_count ? _resources[id].max_level : 0;
+  }
+
+  void resetMaxLevels() {
+    for (uint8_t i = 0; i < _resource_count; i++) _resources[i].max_level = 0;
+  }
+
+  uint32_t getSamples() const { return _samples; }
+
+  private:
+  struct _Task {
+    TaskInterface* task;
+    TickType_t deadline;
+    std::atomic<TickType_t> check_in;
+    bool starved;
+  };
+
+  struct _Resource {
+    const void* object;
+    const char* name;
+    uint8_t (*read)(const void* object);
+    uint8_t threshold;
+    uint8_t hold_samples;
+    uint8_t above;
+    uint8_t level;
+    uint8_t max_level;
+    HealthEvent event;
+  };
+
+  int8_t _watch(const void* const object, const char* name, uint8_t (*read)(const void*),
+                const uint8_t threshold, const uint8_t hold_samples, const HealthEvent event) {
+    if (object == nullptr) return -1;
+
+    LockGuardCRTP<MutexRecursiveStaticCRTP> guard(_lock);
+
+    uint8_t id = 0;
+    while (id < _resource_count && _resources[id].object != nullptr) id++;
+    if (id >= MAX_RESOURCES) return -1;
+    if (id == _resource_count) _resource_count++;
+
+    _Resource& entry   = _resources[id];
+    entry.object       = object;
+    entry.name         = name;
+    entry.read         = read;
+    entry.threshold    = threshold;
+    entry.hold_samples = hold_samples ? hold_samples : 1;
+    entry.above        = 0;
+    entry.level        = 0;
+    entry.max_level    = 0;
+    entry.event        = event;
+    return id;
+  }
+
+  static uint8_t _percent(const uint32_t used, const uint32_t total) {
+    return total ? (uint64_t)used * 100 / total : 0;
+  }
+
+  static uint8_t _queueLevel(const void* object) {
+    const QueueInterface& queue = *static_cast<const QueueInterface*>(object);
+    const uint32_t used         = queue.getAvailableMessages();
+    return _percent(used, used + queue.getAvailableSpaces());
+  }
+
+  static uint8_t _bufferLevel(const void* object) {
+    const DataBufferInterface& buffer = *static_cast<const DataBufferInterface*>(object);
+    const uint32_t used               = buffer.availableBytes();
+    return _percent(used, used + buffer.availableSpaces());
+  }
+
+  static uint8_t _lockLevel(const void* object) {
+    return uxSemaphoreGetCount((SemaphoreHandle_t)object) ? 0 : 100;
+  }
+
+  void _raise(const HealthEvent event, const char* name, const uint32_t value) {
+    if (_callback) _callback(event, name, value, _callback_arg);
+  }
+
+  static void _sample(void* arg) {
+    HealthMonitor& monitor = *static_cast<HealthMonitor*>(arg);
+
+    if (monitor._watchdog && !monitor._watchdog_subscribed) {
+      monitor._watchdog_subscribed = esp_task_wdt_add(nullptr) == ESP_OK;
+    }
+
+    if (monitor._stack_threshold) TaskInterface::forEach(&HealthMonitor::_sampleStack, arg);
+
+    bool healthy;
+    {
+      LockGuardCRTP<MutexRecursiveStaticCRTP> guard(monitor._lock);
+      healthy = monitor._sampleTasks();
+      monitor._sampleResources();
+    }
+    monitor._samples++;
+
+    if (monitor._watchdog_subscribed && healthy) esp_task_wdt_reset();
+  }
+
+  // Raises StackHigh when the high-water mark of a task crosses the threshold
+  static void _sampleStack(TaskInterface& task, void* arg) {
+    HealthMonitor& monitor = *static_cast<HealthMonitor*>(arg);
+    if (!task || task.getStackSize() == 0) return;
+
+    const uint8_t before = _percent(task.getStackMaxUsed(), task.getStackSize());
+    task.updateStackStats();
+    const uint8_t after = _percent(task.getStackMaxUsed(), task.getStackSize());
+
+    if (before < monitor._stack_threshold && after >= monitor._stack_threshold) {
+      monitor._raise(HealthEvent::StackHigh, task.getName(), after);
+    }
+  }
+
+  // Returns false if any watched task is starved
+  bool _sampleTasks() {
+    const TickType_t now = xTaskGetTickCount();
+    bool healthy         = true;
+
+    for (uint8_t i = 0; i < _task_count; i++) {
+      _Task& entry = _tasks[i];
+      if (entry.task == nullptr || !*entry.task) continue;
+
+      const TickType_t since = now - entry.check_in.load(std::memory_order_relaxed);
+
+      if (since <= entry.deadline) {
+        entry.starved = false;
+        continue;
+      }
+
+      healthy = false;
+      if (entry.starved) continue;
+
+      entry.starved = true;
+      _raise(HealthEvent::TaskStarved, entry.task->getName(), since);
+    }
+
+    return healthy;
+  }
+
+  void _sampleResources() {
+    for (uint8_t i = 0; i < _resource_count; i++) {
+      _Resource& entry = _resources[i];
+      if (entry.object == nullptr) continue;
+
+      entry.level     = entry.read(entry.object);
+      entry.max_level = max(entry.max_level, entry.level);
+
+      if (entry.level < entry.threshold) {
+        entry.above = 0;
+        continue;
+      }
+
+      if (entry.above < 0xff) entry.above++;
+      if (entry.above != entry.hold_samples) continue;
+
+      _raise(entry.event, entry.name,
+             entry.event == HealthEvent::LockHeld ? entry.hold_samples : entry.level);
+    }
+  }
+
+  Callback_t _callback;
+  void* _callback_arg;
+  uint8_t _stack_threshold;
+  bool _watchdog;
+  bool _watchdog_subscribed;
+  uint8_t _task_count;
+  uint8_t _resource_count;
+  uint32_t _samples;
+  MutexRecursiveStaticCRTP _lock;
+  _Task _tasks[MAX_TASKS];
+  _Resource _resources[MAX_RESOURCES];
+};
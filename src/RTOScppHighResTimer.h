@@ -0,0 +1,173 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <esp_attr.h>
+#include <esp_timer.h>
+
+class HighResTimer;
+
+typedef void (*HighResTimerCallback_t)(HighResTimer& timer);
+
+// Microsecond timer backed by esp_timer, with the start/stop/reset/setPeriod surface of
+// TimerInterface. Callbacks run in the esp_timer task, or directly in the timer ISR when
+// dispatch_isr is set (needs CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD, and the callback must
+// be IRAM safe). Every expiration is compared against its ideal time to report the jitter
+class HighResTimer {
+  public:
+  HighResTimer()
+      : _handle(nullptr)
+      , _name(nullptr)
+      , _callback(nullptr)
+      , _period(0)
+      , _id(nullptr)
+      , _auto_reload(false)
+      , _start(false)
+      , _dispatch_isr(false)
+      , _expected(0) {
+    resetJitterStats();
+  }
+
+  HighResTimer(const char* name, const HighResTimerCallback_t callback, const uint64_t period_us,
+               void* id, const bool auto_reload, const bool start, const bool dispatch_isr = false)
+      : HighResTimer() {
+    setup(name, callback, period_us, id, auto_reload, start, dispatch_isr);
+    create();
+  }
+
+  ~HighResTimer() {
+    if (_handle == nullptr) return;
+    esp_timer_stop(_handle);
+    esp_timer_delete(_handle);
+  }
+
+  HighResTimer(const HighResTimer&)                = delete;
+  HighResTimer& operator=(const HighResTimer&)     = delete;
+  HighResTimer(HighResTimer&&) noexcept            = delete;
+  HighResTimer& operator=(HighResTimer&&) noexcept = delete;
+
+  void setup(const char* name, const HighResTimerCallback_t callback, const uint64_t period_us,
+             void* id, const bool auto_reload, const bool start, const bool dispatch_isr = false) {
+    _name         = name;
+    _callback     = callback;
+    _period       = period_us;
+    _id           = id;
+    _auto_reload  = auto_reload;
+    _start        = start;
+    _dispatch_isr = dispatch_isr;
+  }
+
+  bool create() {
+    if (_handle) return false;
+
+    esp_timer_create_args_t args = {};
+    args.callback                = &HighResTimer::_onExpire;
+    args.arg                     = this;
+    args.name                    = _name;
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+    args.dispatch_method = _dispatch_isr ? ESP_TIMER_ISR : ESP_TIMER_TASK;
+#else
+    if (_dispatch_isr) return false;
+    args.dispatch_method = ESP_TIMER_TASK;
+#endif
+
+    if (esp_timer_create(&args, &_handle) != ESP_OK) {
+      _handle = nullptr;
+      return false;
+    }
+
+    return _start ? start() : true;
+  }
+
+  bool start() {
+    if (_handle == nullptr || _period == 0) return false;
+
+    _expected = esp_timer_get_time() + _period;
+    return (_auto_reload ? esp_timer_start_periodic(_handle, _period)
+                         : esp_timer_start_once(_handle, _period)) == ESP_OK;
+  }
+
+  bool stop() const { return _handle && esp_timer_stop(_handle) == ESP_OK; }
+
+  bool reset() {
+    if (_handle == nullptr) return false;
+    esp_timer_stop(_handle);
+    return start();
+  }
+
+  bool isActive() const { return _handle && esp_timer_is_active(_handle); }
+
+  // Restarts the timer with the new period if it was running
+  bool setPeriod(const uint64_t period_us) {
+    _period = period_us;
+    return isActive() ? reset() : true;
+  }
+
+  uint64_t getPeriod() const { return _period; }
+  const char* getName() const { return _name; }
+
+  void setTimerID(void* id) { _id = id; }
+  void* getTimerID() const { return _id; }
+
+  void setReloadMode(const bool auto_reload) { _auto_reload = auto_reload; }
+  bool getReloadMode() const { return _auto_reload; }
+
+  // Jitter is the signed difference between the time the callback started and the time the
+  // expiration was due
+  int32_t getLastJitterUs() const { return _jitter_last; }
+  int32_t getMinJitterUs() const { return _jitter_min; }
+  int32_t getMaxJitterUs() const { return _jitter_max; }
+  int32_t getAvgJitterUs() const { return _expirations ? _jitter_sum / (int64_t)_expirations : 0; }
+  uint32_t getExpirations() const { return _expirations; }
+
+  void resetJitterStats() {
+    _jitter_last = 0;
+    _jitter_min  = INT32_MAX;
+    _jitter_max  = INT32_MIN;
+    _jitter_sum  = 0;
+    _expirations = 0;
+  }
+
+  esp_timer_handle_t getHandle() const { return _handle; }
+
+  explicit operator bool() const { return _handle != nullptr; }
+
+  private:
+  // Only ever called through the esp_timer function pointer, so it is not inlined into a flash
+  // caller and its out of line copy keeps IRAM_ATTR for ISR dispatch
+  static void IRAM_ATTR _onExpire(void* arg) {
+    HighResTimer& timer  = *static_cast<HighResTimer*>(arg);
+    const int32_t jitter = esp_timer_get_time() - timer._expected;
+
+    // esp_timer schedules periodic alarms from the previous alarm, not from the callback
+    timer._expected += timer._period;
+
+    timer._jitter_last = jitter;
+    timer._jitter_sum += jitter;
+    timer._expirations++;
+    if (jitter < timer._jitter_min) timer._jitter_min = jitter;
+    if (jitter > timer._jitter_max) timer._jitter_max = jitter;
+
+    if (timer._callback) timer._callback(timer);
+  }
+
+  esp_timer_handle_t _handle;
+  const char* _name;
+  HighResTimerCallback_t _callback;
+  uint64_t _period;
+  void* _id;
+  bool _auto_reload;
+  bool _start;
+  bool _dispatch_isr;
+  int64_t _expected;
+  int32_t _jitter_last;
+  int32_t _jitter_min;
+  int32_t _jitter_max;
+  int64_t _jitter_sum;
+  uint32_t _expirations;
+};
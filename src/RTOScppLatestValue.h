@@ -0,0 +1,103 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+// Cell holding the most recent value written, implemented as a triple buffer: the writer fills a
+// back slot and swaps it with the middle one, the reader swaps the middle slot with its front slot
+// when it holds something newer. Both sides are wait-free and make no kernel call, so writing from
+// an ISR is fine. Meant for one writer (a task or an ISR) and one reader
+template <typename T>
+class LatestValueBase {
+  protected:
+  LatestValueBase(T* const slots)
+      : _slots(slots)
+      , _back(0)
+      , _middle(1)
+      , _front(2)
+      , _writes(0) {}
+
+  T* _slots;
+
+  public:
+  LatestValueBase(const LatestValueBase&)                = delete;
+  LatestValueBase& operator=(const LatestValueBase&)     = delete;
+  LatestValueBase(LatestValueBase&&) noexcept            = delete;
+  LatestValueBase& operator=(LatestValueBase&&) noexcept = delete;
+
+  void write(const T& value) {
+    _slots[_back] = value;
+    _back = _middle.exchange(_back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    _writes.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Same as write(), for symmetry with the other containers
+  void writeFromISR(const T& value) { write(value); }
+
+  // Copies the latest value into var. Returns true if it wasn't read before. Until the first write
+  // var gets the initial content of the slots
+  bool read(T& var) {
+    const bool fresh = hasNew();
+    if (fresh) _front = _middle.exchange(_front, std::memory_order_acq_rel) & INDEX_MASK;
+
+    var = _slots[_front];
+    return fresh;
+  }
+
+  T get() {
+    T var;
+    read(var);
+    return var;
+  }
+
+  bool hasNew() const { return _middle.load(std::memory_order_acquire) & FRESH; }
+
+  uint32_t getWrites() const { return _writes.load(std::memory_order_relaxed); }
+
+  explicit operator bool() const { return _slots != nullptr; }
+
+  private:
+  static constexpr uint8_t INDEX_MASK = 0x03;
+  static constexpr uint8_t FRESH      = 0x04;
+
+  uint8_t _back;
+  std::atomic<uint32_t> _middle;
+  uint8_t _front;
+  std::atomic<uint32_t> _writes;
+};
+
+template <typename T>
+class LatestValueStatic : public LatestValueBase<T> {
+  public:
+  static constexpr uint32_t storageBytes() { return 3 * sizeof(T); }
+  static constexpr uint32_t controlBlockBytes() {
+    return sizeof(LatestValueStatic) - storageBytes();
+  }
+
+  LatestValueStatic(const T& initial = T())
+      : LatestValueBase<T>(_storage)
+      , _storage{initial, initial, initial} {}
+
+  private:
+  T _storage[3];
+};
+
+template <typename T>
+class LatestValueExternalStorage : public LatestValueBase<T> {
+  public:
+  LatestValueExternalStorage()
+      : LatestValueBase<T>(nullptr) {}
+
+  // The buffer must hold 3 items
+  bool init(T* const buffer) {
+    if (this->_slots || buffer == nullptr) return false;
+    this->_slots = buffer;
+    return true;
+  }
+};
@@ -6,13 +6,28 @@
 
 #pragma once
 
+#include "RTOScppTrace.h"
 #include <Arduino.h>
 #include <freertos/queue.h>
 #include <freertos/semphr.h>
 
+// Set to 1 in the build flags to count acquisitions, contended acquisitions and the longest wait of
+// every lock. It changes the layout of LockInterface, so it must have the same value in every
+// translation unit
+#ifndef RTOSCPP_LOCK_STATS
+#define RTOSCPP_LOCK_STATS 0
+#endif
+
 // Forward declaration of QueueSet
 class QueueSet;
 
+struct LockStats {
+  uint32_t acquisitions;
+  uint32_t contended; // Acquisitions that had to wait
+  uint32_t timeouts;
+  TickType_t max_wait_ticks;
+};
+
 class LockInterface {
   private:
   friend class QueueSet;
@@ -22,7 +37,39 @@ class LockInterface {
   LockInterface(SemaphoreHandle_t handle)
       : _handle(handle) {}
 
+  typedef BaseType_t (*_TakeFunction)(SemaphoreHandle_t handle, TickType_t ticks_to_wait);
+
+  // Shared by the plain and the recursive take, so both are traced and counted the same way
+  bool _take(const _TakeFunction function, const TickType_t ticks_to_wait) const {
+    RTOSCPP_TRACE_BEGIN();
+#if RTOSCPP_LOCK_STATS
+    bool result = function(_handle, 0);
+
+    if (!result && ticks_to_wait != 0) {
+      const TickType_t start = xTaskGetTickCount();
+      result                 = function(_handle, ticks_to_wait);
+      const TickType_t wait  = xTaskGetTickCount() - start;
+
+      _stats.contended++;
+      _stats.max_wait_ticks = max(_stats.max_wait_ticks, wait);
+    }
+
+    if (result) {
+      _stats.acquisitions++;
+    } else {
+      _stats.timeouts++;
+    }
+#else
+    const bool result = function(_handle, ticks_to_wait);
+#endif
+    RTOSCPP_TRACE_END(this, TraceOp::LockTake, result);
+    return result;
+  }
+
   SemaphoreHandle_t _handle;
+#if RTOSCPP_LOCK_STATS
+  mutable LockStats _stats = {};
+#endif
 
   public:
   virtual ~LockInterface() {
@@ -34,11 +81,27 @@ class LockInterface {
   LockInterface(LockInterface&&) noexcept            = delete;
   LockInterface& operator=(LockInterface&&) noexcept = delete;
 
+  SemaphoreHandle_t getHandle() const { return _handle; }
+
   virtual bool take(const TickType_t ticks_to_wait = portMAX_DELAY) const {
-    return xSemaphoreTake(_handle, ticks_to_wait);
+    return _take([](SemaphoreHandle_t handle, TickType_t ticks) -> BaseType_t {
+      return xSemaphoreTake(handle, ticks);
+    }, ticks_to_wait);
   }
 
-  virtual bool give() const { return xSemaphoreGive(_handle); }
+  virtual bool give() const {
+    RTOSCPP_TRACE_BEGIN();
+    const bool result = xSemaphoreGive(_handle);
+    RTOSCPP_TRACE_END(this, TraceOp::LockGive, result);
+    return result;
+  }
+
+#if RTOSCPP_LOCK_STATS
+  // Counters are updated without a lock of their own, concurrent takes of a semaphore can lose
+  // counts
+  LockStats getStats() const { return _stats; }
+  void resetStats() { _stats = LockStats{}; }
+#endif
 
   explicit operator bool() const { return _handle != nullptr; }
 };
@@ -55,6 +118,9 @@ class MutexDynamic : public LockInterface {
 
 class MutexStatic : public LockInterface {
   public:
+  static constexpr uint32_t storageBytes() { return 0; }
+  static constexpr uint32_t controlBlockBytes() { return sizeof(MutexStatic); }
+
   MutexStatic()
       : LockInterface(xSemaphoreCreateMutexStatic(&_tcb)) {}
 
@@ -68,22 +134,39 @@ class MutexRecursiveDynamic : public LockInterface {
       : LockInterface(xSemaphoreCreateRecursiveMutex()) {}
 
   bool take(const TickType_t ticks_to_wait = portMAX_DELAY) const override {
-    return xSemaphoreTakeRecursive(_handle, ticks_to_wait);
+    return _take([](SemaphoreHandle_t handle, TickType_t ticks) -> BaseType_t {
+      return xSemaphoreTakeRecursive(handle, ticks);
+    }, ticks_to_wait);
   }
 
-  bool give() const override { return xSemaphoreGiveRecursive(_handle); }
+  bool give() const override {
+    RTOSCPP_TRACE_BEGIN();
+    const bool result = xSemaphoreGiveRecursive(_handle);
+    RTOSCPP_TRACE_END(this, TraceOp::LockGive, result);
+    return result;
+  }
 };
 
 class MutexRecursiveStatic : public LockInterface {
   public:
+  static constexpr uint32_t storageBytes() { return 0; }
+  static constexpr uint32_t controlBlockBytes() { return sizeof(MutexRecursiveStatic); }
+
   MutexRecursiveStatic()
       : LockInterface(xSemaphoreCreateRecursiveMutexStatic(&_tcb)) {}
 
   bool take(const TickType_t ticks_to_wait = portMAX_DELAY) const override {
-    return xSemaphoreTakeRecursive(_handle, ticks_to_wait);
+    return _take([](SemaphoreHandle_t handle, TickType_t ticks) -> BaseType_t {
+      return xSemaphoreTakeRecursive(handle, ticks);
+    }, ticks_to_wait);
   }
 
-  bool give() const override { return xSemaphoreGiveRecursive(_handle); }
+  bool give() const override {
+    RTOSCPP_TRACE_BEGIN();
+    const bool result = xSemaphoreGiveRecursive(_handle);
+    RTOSCPP_TRACE_END(this, TraceOp::LockGive, result);
+    return result;
+  }
 
   private:
   StaticSemaphore_t _tcb;
@@ -112,6 +195,9 @@ class SemaphoreBinaryDynamic : public Semaphore {
 
 class SemaphoreBinaryStatic : public Semaphore {
   public:
+  static constexpr uint32_t storageBytes() { return 0; }
+  static constexpr uint32_t controlBlockBytes() { return sizeof(SemaphoreBinaryStatic); }
+
   SemaphoreBinaryStatic()
       : Semaphore(xSemaphoreCreateBinaryStatic(&_tcb)) {}
 
@@ -127,9 +213,378 @@ class SemaphoreCountingDynamic : public Semaphore {
 
 class SemaphoreCountingStatic : public Semaphore {
   public:
+  static constexpr uint32_t storageBytes() { return 0; }
+  static constexpr uint32_t controlBlockBytes() { return sizeof(SemaphoreCountingStatic); }
+
   SemaphoreCountingStatic(const uint8_t max_count, const uint8_t initial_count = 0)
       : Semaphore(xSemaphoreCreateCountingStatic(max_count, initial_count, &_tcb)) {}
 
   private:
   StaticSemaphore_t _tcb;
-};
\ No newline at end of file
+};
+
+// Takes the lock for the lifetime of the guard. Works with every LockInterface, the recursive
+// mutexes included. Evaluates to false and gives nothing back if the take failed
+class LockGuard {
+  public:
+  explicit LockGuard(const LockInterface& lock, const TickType_t ticks_to_wait = portMAX_DELAY)
+      : _lock(lock)
+      , _owns(lock.take(ticks_to_wait)) {}
+
+  ~LockGuard() {
+    if (_owns) _lock.give();
+  }
+
+  LockGuard(const LockGuard&)            = delete;
+  LockGuard& operator=(const LockGuard&) = delete;
+
+  explicit operator bool() const { return _owns; }
+
+  private:
+  const LockInterface& _lock;
+  const bool _owns;
+};
+
+// Like LockGuard, but the take can time out and ownership can be moved, released or taken again
+class UniqueLock {
+  public:
+  explicit UniqueLock(const LockInterface& lock, const TickType_t ticks_to_wait = portMAX_DELAY)
+      : _lock(&lock)
+      , _owns(lock.take(ticks_to_wait)) {}
+
+  ~UniqueLock() { unlock(); }
+
+  UniqueLock(const UniqueLock&)            = delete;
+  UniqueLock& operator=(const UniqueLock&) = delete;
+
+  UniqueLock(UniqueLock&& other) noexcept
+      : _lock(other._lock)
+      , _owns(other._owns) {
+    other._lock = nullptr;
+    other._owns = false;
+  }
+
+  UniqueLock& operator=(UniqueLock&& other) noexcept {
+    if (this != &other) {
+      unlock();
+      _lock       = other._lock;
+      _owns       = other._owns;
+      other._lock = nullptr;
+      other._owns = false;
+    }
+    return *this;
+  }
+
+  bool lock(const TickType_t ticks_to_wait = portMAX_DELAY) {
+    if (_lock == nullptr) return false;
+    if (!_owns) _owns = _lock->take(ticks_to_wait);
+    return _owns;
+  }
+
+  void unlock() {
+    if (_owns) _lock->give();
+    _owns = false;
+  }
+
+  // Leaves the lock taken without giving it back on destruction
+  const LockInterface* release() {
+    const LockInterface* lock = _lock;
+    _lock                     = nullptr;
+    _owns                     = false;
+    return lock;
+  }
+
+  bool ownsLock() const { return _owns; }
+  explicit operator bool() const { return _owns; }
+
+  private:
+  const LockInterface* _lock;
+  bool _owns;
+};
+
+// Non virtual counterpart of the LockInterface family for hot paths. The derived class picks its
+// take and give functions at compile time, so calls inline down to the FreeRTOS call and there is
+// no vtable. Lock stats are not collected. Use LockInterface where a lock must be chosen at runtime
+//
+// Only Static variants exist, there are no Dynamic ones. Tasks, ring buffers and stream buffers
+// have no CRTP counterpart: their calls are not virtual and already inline, only the destructor is
+template <typename Derived>
+class LockCRTP {
+  protected:
+  LockCRTP(const SemaphoreHandle_t handle)
+      : _handle(handle) {}
+
+  ~LockCRTP() {
+    if (_handle) vSemaphoreDelete(_handle);
+  }
+
+  // Defaults, hidden by the recursive mutex
+  static BaseType_t _takeHandle(const SemaphoreHandle_t handle, const TickType_t ticks_to_wait) {
+    return xSemaphoreTake(handle, ticks_to_wait);
+  }
+
+  static BaseType_t _giveHandle(const SemaphoreHandle_t handle) { return xSemaphoreGive(handle); }
+
+  SemaphoreHandle_t _handle;
+
+  public:
+  LockCRTP(const LockCRTP&)                = delete;
+  LockCRTP& operator=(const LockCRTP&)     = delete;
+  LockCRTP(LockCRTP&&) noexcept            = delete;
+  LockCRTP& operator=(LockCRTP&&) noexcept = delete;
+
+  SemaphoreHandle_t getHandle() const { return _handle; }
+
+  bool take(const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    RTOSCPP_TRACE_BEGIN();
+    const bool result = Derived::_takeHandle(_handle, ticks_to_wait);
+    RTOSCPP_TRACE_END(this, TraceOp::LockTake, result);
+    return result;
+  }
+
+  bool give() const {
+    RTOSCPP_TRACE_BEGIN();
+    const bool result = Derived::_giveHandle(_handle);
+    RTOSCPP_TRACE_END(this, TraceOp::LockGive, result);
+    return result;
+  }
+
+  explicit operator bool() const { return _handle != nullptr; }
+};
+
+template <typename Derived>
+inline bool operator==(const QueueSetMemberHandle_t& queue_set_member,
+                       const LockCRTP<Derived>& lock) {
+  return queue_set_member == lock.getHandle();
+}
+
+template <typename Derived>
+class SemaphoreCRTP : public LockCRTP<Derived> {
+  protected:
+  SemaphoreCRTP(const SemaphoreHandle_t handle)
+      : LockCRTP<Derived>(handle) {}
+
+  public:
+  bool takeFromISR(BaseType_t& task_woken) const {
+    return xSemaphoreTakeFromISR(this->_handle, &task_woken);
+  }
+  bool giveFromISR(BaseType_t& task_woken) const {
+    return xSemaphoreGiveFromISR(this->_handle, &task_woken);
+  }
+  uint8_t getCount() const { return uxSemaphoreGetCount(this->_handle); }
+};
+
+class MutexStaticCRTP : public LockCRTP<MutexStaticCRTP> {
+  public:
+  static constexpr uint32_t storageBytes() { return 0; }
+  static constexpr uint32_t controlBlockBytes() { return sizeof(MutexStaticCRTP); }
+
+  MutexStaticCRTP()
+      : LockCRTP<MutexStaticCRTP>(xSemaphoreCreateMutexStatic(&_tcb)) {}
+
+  private:
+  StaticSemaphore_t _tcb;
+};
+
+class MutexRecursiveStaticCRTP : public LockCRTP<MutexRecursiveStaticCRTP> {
+  public:
+  static constexpr uint32_t storageBytes() { return 0; }
+  static constexpr uint32_t controlBlockBytes() { return sizeof(MutexRecursiveStaticCRTP); }
+
+  MutexRecursiveStaticCRTP()
+      : LockCRTP<MutexRecursiveStaticCRTP>(xSemaphoreCreateRecursiveMutexStatic(&_tcb)) {}
+
+  private:
+  friend class LockCRTP<MutexRecursiveStaticCRTP>;
+
+  static BaseType_t _takeHandle(const SemaphoreHandle_t handle, const TickType_t ticks_to_wait) {
+    return xSemaphoreTakeRecursive(handle, ticks_to_wait);
+  }
+
+  static BaseType_t _giveHandle(const SemaphoreHandle_t handle) {
+    return xSemaphoreGiveRecursive(handle);
+  }
+
+  StaticSemaphore_t _tcb;
+};
+
+class SemaphoreBinaryStaticCRTP : public SemaphoreCRTP<SemaphoreBinaryStaticCRTP> {
+  public:
+  static constexpr uint32_t storageBytes() { return 0; }
+  static constexpr uint32_t controlBlockBytes() { return sizeof(SemaphoreBinaryStaticCRTP); }
+
+  SemaphoreBinaryStaticCRTP()
+      : SemaphoreCRTP<SemaphoreBinaryStaticCRTP>(xSemaphoreCreateBinaryStatic(&_tcb)) {}
+
+  private:
+  StaticSemaphore_t _tcb;
+};
+
+class SemaphoreCountingStaticCRTP : public SemaphoreCRTP<SemaphoreCountingStaticCRTP> {
+  public:
+  static constexpr uint32_t storageBytes() { return 0; }
+  static constexpr uint32_t controlBlockBytes() { return sizeof(SemaphoreCountingStaticCRTP); }
+
+  SemaphoreCountingStaticCRTP(const uint8_t max_count, const uint8_t initial_count = 0)
+      : SemaphoreCRTP<SemaphoreCountingStaticCRTP>(
+          xSemaphoreCreateCountingStatic(max_count, initial_count, &_tcb)) {}
+
+  private:
+  StaticSemaphore_t _tcb;
+};
+
+// LockGuard for the LockCRTP family, e.g. LockGuardCRTP<MutexStaticCRTP> guard(mutex)
+template <typename Derived>
+class LockGuardCRTP {
+  public:
+  explicit LockGuardCRTP(const LockCRTP<Derived>& lock,
+                         const TickType_t ticks_to_wait = portMAX_DELAY)
+      : _lock(lock)
+      , _owns(lock.take(ticks_to_wait)) {}
+
+  ~LockGuardCRTP() {
+    if (_owns) _lock.give();
+  }
+
+  LockGuardCRTP(const LockGuardCRTP&)            = delete;
+  LockGuardCRTP& operator=(const LockGuardCRTP&) = delete;
+
+  explicit operator bool() const { return _owns; }
+
+  private:
+  const LockCRTP<Derived>& _lock;
+  const bool _owns;
+};
+
+// Busy-waits instead of blocking and disables interrupts on the current core while held, so both
+// cores and ISRs can share it. Only for critical sections of a few hundred cycles, no FreeRTOS
+// calls are allowed while it is held
+class SpinLock {
+  public:
+  SpinLock() { portMUX_INITIALIZE(&_mux); }
+
+  SpinLock(const SpinLock&)                = delete;
+  SpinLock& operator=(const SpinLock&)     = delete;
+  SpinLock(SpinLock&&) noexcept            = delete;
+  SpinLock& operator=(SpinLock&&) noexcept = delete;
+
+  // Usable from tasks and ISRs
+  void lock() { portENTER_CRITICAL_SAFE(&_mux); }
+  void unlock() { portEXIT_CRITICAL_SAFE(&_mux); }
+
+  void lockFromISR() { portENTER_CRITICAL_ISR(&_mux); }
+  void unlockFromISR() { portEXIT_CRITICAL_ISR(&_mux); }
+
+  portMUX_TYPE* getHandle() { return &_mux; }
+
+  private:
+  portMUX_TYPE _mux;
+};
+
+class SpinLockGuard {
+  public:
+  explicit SpinLockGuard(SpinLock& lock)
+      : _lock(lock) {
+    _lock.lock();
+  }
+
+  ~SpinLockGuard() { _lock.unlock(); }
+
+  SpinLockGuard(const SpinLockGuard&)            = delete;
+  SpinLockGuard& operator=(const SpinLockGuard&) = delete;
+
+  private:
+  SpinLock& _lock;
+};
+
+// Many readers or a single writer. A waiting writer holds the turnstile mutex, so new readers queue
+// behind it and writers don't starve. Readers only touch the turnstile and a spinlock protected
+// counter, they never wait on each other
+class RWLockStatic {
+  public:
+  static constexpr uint32_t storageBytes() { return 0; }
+  static constexpr uint32_t controlBlockBytes() { return sizeof(RWLockStatic); }
+
+  RWLockStatic()
+      : _turnstile(xSemaphoreCreateMutexStatic(&_turnstile_tcb))
+      , _no_readers(xSemaphoreCreateBinaryStatic(&_no_readers_tcb))
+      , _readers(0)
+      , _writer_waiting(false) {
+    portMUX_INITIALIZE(&_mux);
+  }
+
+  ~RWLockStatic() {
+    if (_turnstile) vSemaphoreDelete(_turnstile);
+    if (_no_readers) vSemaphoreDelete(_no_readers);
+  }
+
+  RWLockStatic(const RWLockStatic&)                = delete;
+  RWLockStatic& operator=(const RWLockStatic&)     = delete;
+  RWLockStatic(RWLockStatic&&) noexcept            = delete;
+  RWLockStatic& operator=(RWLockStatic&&) noexcept = delete;
+
+  bool readLock(const TickType_t ticks_to_wait = portMAX_DELAY) {
+    if (!xSemaphoreTake(_turnstile, ticks_to_wait)) return false;
+
+    // Counted while the turnstile is held, so a writer either waits for this reader or blocks it
+    portENTER_CRITICAL(&_mux);
+    _readers++;
+    portEXIT_CRITICAL(&_mux);
+
+    xSemaphoreGive(_turnstile);
+    return true;
+  }
+
+  void readUnlock() {
+    portENTER_CRITICAL(&_mux);
+    const bool wake_writer = (--_readers == 0) && _writer_waiting;
+    portEXIT_CRITICAL(&_mux);
+
+    if (wake_writer) xSemaphoreGive(_no_readers);
+  }
+
+  bool writeLock(const TickType_t ticks_to_wait = portMAX_DELAY) {
+    TimeOut_t timeout;
+    TickType_t remaining = ticks_to_wait;
+    vTaskSetTimeOutState(&timeout);
+
+    if (!xSemaphoreTake(_turnstile, ticks_to_wait)) return false;
+
+    while (true) {
+      portENTER_CRITICAL(&_mux);
+      const bool idle = _readers == 0;
+      _writer_waiting = !idle;
+      portEXIT_CRITICAL(&_mux);
+
+      if (idle) return true;
+
+      // The semaphore can hold a stale give from a previous writer, so the count is checked again
+      if (xTaskCheckForTimeOut(&timeout, &remaining) || !xSemaphoreTake(_no_readers, remaining)) {
+        portENTER_CRITICAL(&_mux);
+        const bool acquired = _readers == 0;
+        _writer_waiting     = false;
+        portEXIT_CRITICAL(&_mux);
+
+        if (acquired) return true;
+
+        xSemaphoreGive(_turnstile);
+        return false;
+      }
+    }
+  }
+
+  void writeUnlock() { xSemaphoreGive(_turnstile); }
+
+  uint32_t getReaders() const { return _readers; }
+
+  explicit operator bool() const { return _turnstile != nullptr && _no_readers != nullptr; }
+
+  private:
+  StaticSemaphore_t _turnstile_tcb;
+  StaticSemaphore_t _no_readers_tcb;
+  SemaphoreHandle_t _turnstile;
+  SemaphoreHandle_t _no_readers;
+  portMUX_TYPE _mux;
+  uint32_t _readers;
+  bool _writer_waiting;
+};
@@ -0,0 +1,78 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+// Placement policies for the storage of the Placed containers. Their kernel control block is
+// always heap allocated from internal RAM on construction, only the item storage follows the
+// policy. Placed containers are not allocation free, use the Static ones for that
+//
+// MemoryInternal is also the one for data touched while the flash cache is disabled (IRAM ISRs,
+// flash writes): internal DRAM stays reachable then, PSRAM goes through the cache and doesn't
+struct MemoryInternal {
+  static constexpr uint32_t CAPS = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+};
+
+struct MemoryDma {
+  static constexpr uint32_t CAPS = MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+};
+
+struct MemoryPsram {
+  static constexpr uint32_t CAPS = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+};
+
+// Owns a block allocated with heap_caps_malloc for the lifetime of the container
+template <uint32_t CAPS>
+class _MemoryBlock {
+  public:
+  _MemoryBlock(const size_t bytes)
+      : _data(heap_caps_malloc(bytes ? bytes : 1, CAPS)) {}
+
+  ~_MemoryBlock() {
+    if (_data) heap_caps_free(_data);
+  }
+
+  _MemoryBlock(const _MemoryBlock&)                = delete;
+  _MemoryBlock& operator=(const _MemoryBlock&)     = delete;
+  _MemoryBlock(_MemoryBlock&&) noexcept            = delete;
+  _MemoryBlock& operator=(_MemoryBlock&&) noexcept = delete;
+
+  template <typename U>
+  U* as() const {
+    return static_cast<U*>(_data);
+  }
+
+  explicit operator bool() const { return _data != nullptr; }
+
+  private:
+  void* const _data;
+};
+
+typedef _MemoryBlock<MemoryInternal::CAPS> _ControlBlock;
+
+// Sum of the storage and control block bytes of the given containers, to check a memory budget at
+// build time: static_assert(MemoryFootprint<QueueStatic<int, 8>, TaskStatic<4096>>::BYTES < ...)
+//
+// storageBytes() is the item storage of a container and controlBlockBytes() everything else it
+// takes: the wrapper object and the kernel control block. For Static types both add up to
+// sizeof(), Placed types also count their control block allocated in internal RAM. Heap
+// bookkeeping is not included
+template <typename... Containers>
+struct MemoryFootprint;
+
+template <>
+struct MemoryFootprint<> {
+  static constexpr uint32_t BYTES = 0;
+};
+
+template <typename C, typename... Containers>
+struct MemoryFootprint<C, Containers...> {
+  static constexpr uint32_t BYTES =
+    C::storageBytes() + C::controlBlockBytes() + MemoryFootprint<Containers...>::BYTES;
+};
@@ -0,0 +1,155 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "RTOScppQueue.h"
+#include <Arduino.h>
+#include <atomic>
+
+// Fixed-block pool of T. allocate() and free() are lock-free and O(1), so they can be called from
+// tasks on both cores and from ISRs. Blocks are raw storage, T constructors are not called
+template <typename T>
+class MemoryPoolBase {
+  protected:
+  static constexpr uint16_t EMPTY = 0xffff;
+
+  MemoryPoolBase(T* const storage, uint16_t* const next, const uint16_t length)
+      : _storage(storage)
+      , _next(next)
+      , _length(length)
+      , _head(EMPTY)
+      , _available(0) {}
+
+  // Links every block into the free list. The tag in the upper 16 bits of the head is incremented
+  // on every update to avoid ABA problems
+  void _init() {
+    for (uint16_t i = 0; i < _length; i++) _next[i] = (i + 1 < _length) ? i + 1 : EMPTY;
+    _head.store(_length ? 0 : EMPTY, std::memory_order_release);
+    _available.store(_length, std::memory_order_release);
+  }
+
+  T* const _storage;
+  uint16_t* const _next;
+  const uint16_t _length;
+  std::atomic<uint32_t> _head;
+  std::atomic<uint32_t> _available;
+
+  public:
+  MemoryPoolBase(const MemoryPoolBase&)                = delete;
+  MemoryPoolBase& operator=(const MemoryPoolBase&)     = delete;
+  MemoryPoolBase(MemoryPoolBase&&) noexcept            = delete;
+  MemoryPoolBase& operator=(MemoryPoolBase&&) noexcept = delete;
+
+  // Returns nullptr when the pool is exhausted
+  T* allocate() {
+    uint32_t head = _head.load(std::memory_order_acquire);
+
+    while (true) {
+      const uint16_t index = head & 0xffff;
+      if (index == EMPTY) return nullptr;
+
+      const uint32_t new_head = ((head + 0x10000) & 0xffff0000) | _next[index];
+      if (_head.compare_exchange_weak(
+            head, new_head, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        _available.fetch_sub(1, std::memory_order_relaxed);
+        return &_storage[index];
+      }
+    }
+  }
+
+  bool free(T* const item) {
+    if (!owns(item)) return false;
+
+    const uint16_t index = item - _storage;
+    uint32_t head        = _head.load(std::memory_order_acquire);
+
+    while (true) {
+      _next[index]            = head & 0xffff;
+      const uint32_t new_head = ((head + 0x10000) & 0xffff0000) | index;
+      if (_head.compare_exchange_weak(
+            head, new_head, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        _available.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+  }
+
+  bool owns(const T* const item) const {
+    return item >= _storage && item < _storage + _length;
+  }
+
+  uint32_t getLength() const { return _length; }
+  uint32_t getAvailable() const { return _available.load(std::memory_order_relaxed); }
+  bool isEmpty() const { return getAvailable() == 0; }
+};
+
+template <typename T, uint16_t LENGTH>
+class MemoryPoolStatic : public MemoryPoolBase<T> {
+  static_assert(LENGTH > 0 && LENGTH < 0xffff, "LENGTH must be between 1 and 65534");
+
+  public:
+  // The free list counts as the control block
+  static constexpr uint32_t storageBytes() { return LENGTH * sizeof(T); }
+  static constexpr uint32_t controlBlockBytes() {
+    return sizeof(MemoryPoolStatic) - storageBytes();
+  }
+  static constexpr uint32_t capacityItems() { return LENGTH; }
+
+  MemoryPoolStatic()
+      : MemoryPoolBase<T>(reinterpret_cast<T*>(_storage), _next, LENGTH) {
+    this->_init();
+  }
+
+  private:
+  alignas(T) uint8_t _storage[LENGTH * sizeof(T)];
+  uint16_t _next[LENGTH];
+};
+
+// Passes blocks of a memory pool through a queue of pointers, so large messages cost a pointer copy.
+// The receiver owns the block and must hand it back with release()
+template <typename T>
+class PoolQueue {
+  public:
+  PoolQueue(MemoryPoolBase<T>& pool, const _QueueBase<T*>& queue)
+      : _pool(pool)
+      , _queue(queue) {}
+
+  PoolQueue(const PoolQueue&)                = delete;
+  PoolQueue& operator=(const PoolQueue&)     = delete;
+  PoolQueue(PoolQueue&&) noexcept            = delete;
+  PoolQueue& operator=(PoolQueue&&) noexcept = delete;
+
+  T* allocate() { return _pool.allocate(); }
+  bool release(T* const item) { return _pool.free(item); }
+
+  // On failure the block still belongs to the caller
+  bool send(T* const item, const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    return _queue.add(item, ticks_to_wait);
+  }
+
+  bool sendFromISR(T* const item, BaseType_t& task_woken) const {
+    return _queue.addFromISR(item, task_woken);
+  }
+
+  // Returns nullptr on timeout
+  T* receive(const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    T* item = nullptr;
+    return _queue.pop(item, ticks_to_wait) ? item : nullptr;
+  }
+
+  T* receiveFromISR(BaseType_t& task_woken) const {
+    T* item = nullptr;
+    return _queue.popFromISR(item, task_woken) ? item : nullptr;
+  }
+
+  MemoryPoolBase<T>& getPool() const { return _pool; }
+  const _QueueBase<T*>& getQueue() const { return _queue; }
+
+  private:
+  MemoryPoolBase<T>& _pool;
+  const _QueueBase<T*>& _queue;
+};
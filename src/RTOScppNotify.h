@@ -0,0 +1,144 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "RTOScppTask.h"
+#include <Arduino.h>
+#include <freertos/task.h>
+#include <type_traits>
+
+// Notification index used by default by the primitives of this header, Broadcast and CoScheduler.
+// Index 0 belongs to TaskInterface::notify*() and to the IDF drivers, so these need a second entry:
+// set CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES to 2 or more in the sdkconfig
+#define RTOSCPP_NOTIFY_DEFAULT_INDEX (configTASK_NOTIFICATION_ARRAY_ENTRIES - 1)
+
+static_assert(configTASK_NOTIFICATION_ARRAY_ENTRIES > 1,
+              "Notification primitives need CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES > 1");
+
+// Common part of the notification based primitives. Only the owner task can wait on them. The
+// owner is either the TaskInterface given on construction or, if none, the last task that waited
+class NotifyInterface {
+  protected:
+  NotifyInterface(const TaskInterface* const owner, const UBaseType_t index)
+      : _owner(owner)
+      , _task(nullptr)
+      , _index(index) {}
+
+  TaskHandle_t _target() const { return _owner ? _owner->getHandle() : _task; }
+
+  void _bindCurrentTask() {
+    if (_owner == nullptr) _task = xTaskGetCurrentTaskHandle();
+  }
+
+  const TaskInterface* const _owner;
+  TaskHandle_t _task;
+  const UBaseType_t _index;
+
+  public:
+  NotifyInterface(const NotifyInterface&)                = delete;
+  NotifyInterface& operator=(const NotifyInterface&)     = delete;
+  NotifyInterface(NotifyInterface&&) noexcept            = delete;
+  NotifyInterface& operator=(NotifyInterface&&) noexcept = delete;
+
+  // Binds the primitive to a task without waiting first
+  void bind(const TaskHandle_t task) { _task = task; }
+
+  UBaseType_t getIndex() const { return _index; }
+
+  explicit operator bool() const { return _target() != nullptr; }
+};
+
+// Counting (or binary) semaphore on the owner task's notification value. Same take/give interface
+// as Semaphore without a kernel object. takeFromISR() is not available, only the owner task can
+// take it
+class NotifySemaphore : public NotifyInterface {
+  public:
+  NotifySemaphore(const bool binary = false,
+                  const UBaseType_t index = RTOSCPP_NOTIFY_DEFAULT_INDEX)
+      : NotifyInterface(nullptr, index)
+      , _binary(binary) {}
+
+  NotifySemaphore(const TaskInterface& owner, const bool binary = false,
+                  const UBaseType_t index = RTOSCPP_NOTIFY_DEFAULT_INDEX)
+      : NotifyInterface(&owner, index)
+      , _binary(binary) {}
+
+  bool take(const TickType_t ticks_to_wait = portMAX_DELAY) {
+    _bindCurrentTask();
+    return ulTaskNotifyTakeIndexed(_index, _binary, ticks_to_wait) != 0;
+  }
+
+  bool give() const {
+    const TaskHandle_t task = _target();
+    if (task == nullptr) return false;
+    return xTaskNotifyGiveIndexed(task, _index);
+  }
+
+  bool giveFromISR(BaseType_t& task_woken) const {
+    const TaskHandle_t task = _target();
+    if (task == nullptr) return false;
+    vTaskNotifyGiveIndexedFromISR(task, _index, &task_woken);
+    return true;
+  }
+
+  uint32_t getCount() const {
+    const TaskHandle_t task = _target();
+    if (task == nullptr) return 0;
+    return ulTaskNotifyValueClearIndexed(task, _index, 0);
+  }
+
+  private:
+  const bool _binary;
+};
+
+// Single slot mailbox on the owner task's notification value. A send overwrites the previous value
+// unless overwrite is false, in which case it fails while a value is pending
+template <typename T = uint32_t>
+class NotifyMailbox : public NotifyInterface {
+  static_assert(sizeof(T) <= sizeof(uint32_t) && std::is_trivially_copyable<T>::value,
+                "T must fit in a notification value");
+
+  public:
+  NotifyMailbox(const UBaseType_t index = RTOSCPP_NOTIFY_DEFAULT_INDEX)
+      : NotifyInterface(nullptr, index) {}
+
+  NotifyMailbox(const TaskInterface& owner, const UBaseType_t index = RTOSCPP_NOTIFY_DEFAULT_INDEX)
+      : NotifyInterface(&owner, index) {}
+
+  bool send(const T& value, const bool overwrite = true) const {
+    const TaskHandle_t task = _target();
+    if (task == nullptr) return false;
+    return xTaskNotifyIndexed(task, _index, _pack(value), _action(overwrite));
+  }
+
+  bool sendFromISR(const T& value, BaseType_t& task_woken, const bool overwrite = true) const {
+    const TaskHandle_t task = _target();
+    if (task == nullptr) return false;
+    return xTaskNotifyIndexedFromISR(task, _index, _pack(value), _action(overwrite), &task_woken);
+  }
+
+  bool receive(T& value, const TickType_t ticks_to_wait = portMAX_DELAY) {
+    _bindCurrentTask();
+
+    uint32_t raw = 0;
+    if (!xTaskNotifyWaitIndexed(_index, 0, 0, &raw, ticks_to_wait)) return false;
+
+    memcpy(&value, &raw, sizeof(T));
+    return true;
+  }
+
+  private:
+  static uint32_t _pack(const T& value) {
+    uint32_t raw = 0;
+    memcpy(&raw, &value, sizeof(T));
+    return raw;
+  }
+
+  static eNotifyAction _action(const bool overwrite) {
+    return overwrite ? eSetValueWithOverwrite : eSetValueWithoutOverwrite;
+  }
+};
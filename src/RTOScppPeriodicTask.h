@@ -0,0 +1,123 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "RTOScppTask.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+
+// What to do with the releases missed when a cycle runs longer than the period
+enum class OverrunPolicy : uint8_t {
+  Skip,    // Drop the missed releases and keep the original phase
+  CatchUp, // Run the missed releases back to back
+};
+
+// Static task that runs a callback every period ticks with xTaskDelayUntil, so the rate doesn't
+// drift with the execution time of the callback. Execution time and overruns are recorded
+template <uint32_t STACK_SIZE>
+class PeriodicTask : public TaskStatic<STACK_SIZE> {
+  public:
+  typedef void (*Callback_t)(void* arg);
+  typedef void (*OverrunHook_t)(PeriodicTask& task, uint32_t missed, void* arg);
+
+  PeriodicTask(const char* name, const Callback_t callback, void* arg, const TickType_t period,
+               const uint8_t priority, const BaseType_t running_core = ARDUINO_RUNNING_CORE,
+               const OverrunPolicy policy = OverrunPolicy::Skip)
+      : TaskStatic<STACK_SIZE>(name, &PeriodicTask::_run, priority, running_core, this)
+      , _callback(callback)
+      , _arg(arg)
+      , _period(period ? period : 1)
+      , _policy(policy)
+      , _overrun_hook(nullptr)
+      , _overrun_arg(nullptr) {
+    resetTimingStats();
+  }
+
+  // Takes effect on the next release
+  void setPeriod(const TickType_t period) { _period = period ? period : 1; }
+  TickType_t getPeriod() const { return _period; }
+
+  void setOverrunPolicy(const OverrunPolicy policy) { _policy = policy; }
+  OverrunPolicy getOverrunPolicy() const { return _policy; }
+
+  // Called from the task itself, before the policy is applied
+  void setOverrunHook(const OverrunHook_t hook, void* arg = nullptr) {
+    _overrun_hook = hook;
+    _overrun_arg  = arg;
+  }
+
+  uint32_t getCycles() const { return _cycles; }
+  uint32_t getOverruns() const { return _overruns; }
+  uint32_t getMissedReleases() const { return _missed; }
+  uint32_t getExecMinUs() const { return _exec_min; }
+  uint32_t getExecMaxUs() const { return _exec_max; }
+  uint32_t getExecAvgUs() const { return _cycles ? _exec_sum / _cycles : 0; }
+
+  void resetTimingStats() {
+    _cycles   = 0;
+    _overruns = 0;
+    _missed   = 0;
+    _exec_min = 0xffffffff;
+    _exec_max = 0;
+    _exec_sum = 0;
+  }
+
+  private:
+  static void _run(void* parameter) {
+    PeriodicTask& task   = *static_cast<PeriodicTask*>(parameter);
+    TickType_t last_wake = xTaskGetTickCount();
+    uint32_t pending     = 0; // Missed releases already counted and still to run with CatchUp
+
+    while (true) {
+      const int64_t start = esp_timer_get_time();
+      if (task._callback) task._callback(task._arg);
+      task._record(esp_timer_get_time() - start);
+
+      // Releases passed since the one of this cycle. With CatchUp the backlog runs late, so only
+      // the releases missed since the previous cycle count as a new overrun
+      const TickType_t period = task._period;
+      const uint32_t due      = (xTaskGetTickCount() - last_wake) / period;
+
+      if (due > pending) {
+        const uint32_t missed = due - pending;
+        task._overruns++;
+        task._missed += missed;
+
+        if (task._overrun_hook) task._overrun_hook(task, missed, task._overrun_arg);
+      }
+
+      if (task._policy == OverrunPolicy::Skip) {
+        last_wake += due * period;
+        pending = 0;
+      } else {
+        pending = due ? due - 1 : 0;
+      }
+
+      xTaskDelayUntil(&last_wake, period);
+    }
+  }
+
+  void _record(const uint32_t exec_us) {
+    _cycles++;
+    _exec_sum += exec_us;
+    _exec_min = min(_exec_min, exec_us);
+    _exec_max = max(_exec_max, exec_us);
+  }
+
+  const Callback_t _callback;
+  void* const _arg;
+  TickType_t _period;
+  OverrunPolicy _policy;
+  OverrunHook_t _overrun_hook;
+  void* _overrun_arg;
+  uint32_t _cycles;
+  uint32_t _overruns;
+  uint32_t _missed;
+  uint32_t _exec_min;
+  uint32_t _exec_max;
+  uint64_t _exec_sum;
+};
@@ -0,0 +1,222 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "RTOScppBuffer.h"
+#include "RTOScppRingBuffer.h"
+#include "RTOScppTask.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+
+// Transforms a batch of input bytes into output, returning the bytes written to output. Returning 0
+// sends nothing
+typedef uint32_t (*PipelineTransform_t)(const uint8_t* input, uint32_t input_size, uint8_t* output,
+                                        uint32_t output_size, void* arg);
+
+// Output of a stage that ends the pipeline, its transform consumes the data itself
+struct PipelineSink {};
+
+struct PipelineStageStats {
+  uint32_t batches;
+  uint32_t backpressure; // Sends that found the output full
+  uint32_t dropped;      // Batches lost because the output stayed full past the send timeout
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+  uint64_t busy_us;    // Time spent in the transform
+  uint64_t blocked_us; // Time spent waiting for the output
+};
+
+// Inputs whose batches have to be copied before the transform sees them. Items of no split and
+// byte ring buffers are handed over in place
+constexpr bool _pipelineCopies(const DataBufferInterface*) { return true; }
+template <typename T>
+constexpr bool _pipelineCopies(const RingBufferSplitBase<T>*) {
+  return true;
+}
+constexpr bool _pipelineCopies(const RingBufferInterface*) { return false; }
+
+// Task that moves data from INPUT to OUTPUT through a transform, one batch at a time. INPUT is a
+// stream or message buffer or a ring buffer, OUTPUT is one of those or PipelineSink. Stages are
+// chained by using the output of one as the input of the next, each on its own core and priority.
+//
+// OUTPUT_SIZE is the room given to the transform. Without a transform it is left at 0 and the
+// batch is forwarded as is, so data from a ring buffer reaches the output with a single copy. A
+// full output blocks the stage up to the send timeout (backpressure), after which the batch is
+// dropped. A message buffer input hands over one whole message per batch: a message longer than
+// BATCH_SIZE can't be received and blocks the stage, so init() fails unless the largest message
+// fits. See setMaxMessageSize()
+template <uint32_t STACK_SIZE, typename INPUT, typename OUTPUT, uint32_t BATCH_SIZE,
+          uint32_t OUTPUT_SIZE = 0>
+class PipelineStage : public TaskStatic<STACK_SIZE> {
+  static_assert(BATCH_SIZE > 0, "BATCH_SIZE must be greater than 0");
+
+  public:
+  PipelineStage(const char* name, INPUT& input, const PipelineTransform_t transform, void* arg,
+                OUTPUT& output, const uint8_t priority,
+                const BaseType_t running_core = ARDUINO_RUNNING_CORE)
+      : TaskStatic<STACK_SIZE>(name, &PipelineStage::_run, priority, running_core, this)
+      , _input(input)
+      , _output(output)
+      , _transform(transform)
+      , _arg(arg)
+      , _batch_size(BATCH_SIZE)
+      , _batch_ticks(0)
+      , _send_ticks(portMAX_DELAY)
+      , _max_message(0)
+      , _stats{} {}
+
+  // Fails if a transform is given without OUTPUT_SIZE or a message from the input can't fit
+  bool init() {
+    if (_transform && OUTPUT_SIZE == 0) return false;
+    if (!_fits(_input)) return false;
+    return TaskStatic<STACK_SIZE>::init();
+  }
+
+  // Bytes collected before running the transform, up to BATCH_SIZE. Ring buffer items and
+  // messages are handed over whole
+  void setBatchSize(const uint32_t bytes) {
+    _batch_size = bytes == 0 ? 1 : (bytes > BATCH_SIZE ? BATCH_SIZE : bytes);
+  }
+  uint32_t getBatchSize() const { return _batch_size; }
+
+  // Extra time to fill a batch after its first bytes arrive, for stream buffer inputs
+  void setBatchTimeout(const TickType_t ticks) { _batch_ticks = ticks; }
+  TickType_t getBatchTimeout() const { return _batch_ticks; }
+
+  void setSendTimeout(const TickType_t ticks) { _send_ticks = ticks; }
+  TickType_t getSendTimeout() const { return _send_ticks; }
+
+  // Largest message the producers send to a message buffer input, checked by init() against
+  // BATCH_SIZE. With 0, the default, it is the largest message the buffer can hold, so a buffer
+  // larger than a batch needs it set
+  void setMaxMessageSize(const uint32_t bytes) { _max_message = bytes; }
+  uint32_t getMaxMessageSize() const { return _max_message; }
+
+  const PipelineStageStats& getStats() const { return _stats; }
+  void resetStats() { _stats = {}; }
+
+  private:
+  static void _run(void* parameter) {
+    PipelineStage& stage = *static_cast<PipelineStage*>(parameter);
+    while (true) _receive(stage._input, stage);
+  }
+
+  void _process(const uint8_t* data, uint32_t size) {
+    _stats.batches++;
+    _stats.bytes_in += size;
+
+    if (_transform) {
+      const int64_t start = esp_timer_get_time();
+      size                = _transform(data, size, _output_buffer, OUTPUT_SIZE, _arg);
+      data                = _output_buffer;
+      _stats.busy_us += esp_timer_get_time() - start;
+    }
+
+    if (size == 0) return;
+
+    // Try without blocking first, so only the sends that had to wait count as backpressure
+    uint32_t sent = _send(_output, data, size, 0);
+
+    if (sent < size) {
+      _stats.backpressure++;
+      const int64_t start = esp_timer_get_time();
+      sent += _send(_output, data + sent, size - sent, _send_ticks);
+      _stats.blocked_us += esp_timer_get_time() - start;
+    }
+
+    _stats.bytes_out += sent;
+    if (sent < size) _stats.dropped++;
+  }
+
+  // Each message takes a length header of sizeof(size_t) bytes from the capacity
+  bool _fits(const DataBufferInterface& input) const {
+    if (!input.isMessageBuffer()) return true;
+    if (_max_message) return _max_message <= BATCH_SIZE;
+
+    const uint32_t capacity = input.availableBytes() + input.availableSpaces();
+    return capacity <= BATCH_SIZE + sizeof(size_t);
+  }
+
+  bool _fits(const RingBufferInterface&) const { return true; }
+
+  // A message larger than the batch would be left in the buffer, so messages are received with
+  // the whole input buffer
+  static void _receive(const DataBufferInterface& input, PipelineStage& stage) {
+    const uint32_t bytes    = input.isMessageBuffer() ? BATCH_SIZE : stage._batch_size;
+    const uint32_t received = input.receiveBatch(stage._input_buffer, bytes, stage._batch_ticks);
+    if (received) stage._process(stage._input_buffer, received);
+  }
+
+  template <typename T>
+  static void _receive(const RingBufferByteBase<T>& input, PipelineStage& stage) {
+    RingBufferItem<T> item = input.receiveItemUpTo(stage._batch_size);
+    if (item) stage._process(reinterpret_cast<const uint8_t*>(item.get()), item.size());
+  }
+
+  template <typename T>
+  static void _receive(const RingBufferNoSplitBase<T>& input, PipelineStage& stage) {
+    RingBufferItem<T> item = input.receiveItem();
+    if (item) stage._process(reinterpret_cast<const uint8_t*>(item.get()), item.size());
+  }
+
+  // A split item is joined in the input buffer when it fits, so the transform sees whole items
+  template <typename T>
+  static void _receive(const RingBufferSplitBase<T>& input, PipelineStage& stage) {
+    RingBufferSplitItem<T> item = input.receiveItem();
+    if (!item) return;
+
+    if (!item.isSplit() || item.size() > BATCH_SIZE) {
+      stage._process(reinterpret_cast<const uint8_t*>(item.head()), item.headSize());
+      if (item.isSplit()) {
+        stage._process(reinterpret_cast<const uint8_t*>(item.tail()), item.tailSize());
+      }
+      return;
+    }
+
+    memcpy(stage._input_buffer, item.head(), item.headSize());
+    memcpy(stage._input_buffer + item.headSize(), item.tail(), item.tailSize());
+    const uint32_t size = item.size();
+    item.release();
+    stage._process(stage._input_buffer, size);
+  }
+
+  // Each returns the bytes sent. Only stream buffers can take part of a batch
+  static uint32_t _send(const DataBufferInterface& output, const uint8_t* data,
+                        const uint32_t size, const TickType_t ticks_to_wait) {
+    return output.send(data, size, ticks_to_wait);
+  }
+
+  template <typename T>
+  static uint32_t _send(const RingBufferBase<T>& output, const uint8_t* data, const uint32_t size,
+                        const TickType_t ticks_to_wait) {
+    return output.send(reinterpret_cast<const T*>(data), size, ticks_to_wait) ? size : 0;
+  }
+
+  static uint32_t _send(PipelineSink&, const uint8_t*, const uint32_t size, const TickType_t) {
+    return size;
+  }
+
+  INPUT& _input;
+  OUTPUT& _output;
+  const PipelineTransform_t _transform;
+  void* const _arg;
+  uint32_t _batch_size;
+  TickType_t _batch_ticks;
+  TickType_t _send_ticks;
+  uint32_t _max_message;
+  PipelineStageStats _stats;
+  uint8_t _input_buffer[_pipelineCopies(static_cast<INPUT*>(nullptr)) ? BATCH_SIZE : 1];
+  uint8_t _output_buffer[OUTPUT_SIZE ? OUTPUT_SIZE : 1];
+};
+
+// Starts every stage of a pipeline. Returns false as soon as one fails
+inline bool pipelineInit() { return true; }
+
+template <typename Stage, typename... Stages>
+bool pipelineInit(Stage& stage, Stages&... stages) {
+  return stage.init() && pipelineInit(stages...);
+}
@@ -0,0 +1,191 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "RTOScppQueue.h"
+#include <Arduino.h>
+#include <freertos/semphr.h>
+
+// Queue where pop() always returns the oldest item of the highest non-empty level. Higher level
+// numbers have higher priority, like task priorities. The LENGTH slots are shared by every level.
+//
+// The handle is a counting semaphore of the items waiting, so the queue can be added to a QueueSet
+// and the QueueInterface getters work as usual.
+template <typename T, uint32_t LENGTH, uint8_t LEVELS>
+class PriorityQueueStatic : public QueueInterface {
+  static_assert(LENGTH > 0 && LENGTH < 0xffff, "LENGTH must be between 1 and 65534");
+  static_assert(LEVELS > 0 && LEVELS <= 32, "LEVELS must be between 1 and 32");
+
+  public:
+  // Everything but the items counts as the control block: both semaphores and the index lists
+  static constexpr uint32_t storageBytes() { return LENGTH * sizeof(T); }
+  static constexpr uint32_t controlBlockBytes() {
+    return sizeof(PriorityQueueStatic) - storageBytes();
+  }
+  static constexpr uint32_t capacityItems() { return LENGTH; }
+
+  PriorityQueueStatic()
+      : QueueInterface(xSemaphoreCreateCountingStatic(LENGTH, 0, &_items_tcb))
+      , _spaces(xSemaphoreCreateCountingStatic(LENGTH, LENGTH, &_spaces_tcb))
+      , _bitmap(0)
+      , _free(0) {
+    portMUX_INITIALIZE(&_mux);
+
+    for (uint32_t i = 0; i < LENGTH; i++) _next[i] = (i + 1 < LENGTH) ? i + 1 : EMPTY;
+    for (uint8_t i = 0; i < LEVELS; i++) _head[i] = _tail[i] = EMPTY;
+  }
+
+  ~PriorityQueueStatic() {
+    if (_spaces) vSemaphoreDelete(_spaces);
+  }
+
+  // Can't be reset atomically with the slot lists
+  void reset() const = delete;
+
+  uint32_t getLevels() const { return LEVELS; }
+
+  // Adds the item at the back of its level
+  bool add(const T& item, const uint8_t level, const TickType_t ticks_to_wait = portMAX_DELAY) {
+    if (level >= LEVELS || !xSemaphoreTake(_spaces, ticks_to_wait)) return false;
+
+    portENTER_CRITICAL(&_mux);
+    _link(item, level, false);
+    portEXIT_CRITICAL(&_mux);
+
+    xSemaphoreGive(_handle);
+    return true;
+  }
+
+  // Adds the item at the front of its level
+  bool push(const T& item, const uint8_t level, const TickType_t ticks_to_wait = portMAX_DELAY) {
+    if (level >= LEVELS || !xSemaphoreTake(_spaces, ticks_to_wait)) return false;
+
+    portENTER_CRITICAL(&_mux);
+    _link(item, level, true);
+    portEXIT_CRITICAL(&_mux);
+
+    xSemaphoreGive(_handle);
+    return true;
+  }
+
+  bool pop(T& var, const TickType_t ticks_to_wait = portMAX_DELAY) {
+    if (!xSemaphoreTake(_handle, ticks_to_wait)) return false;
+
+    portENTER_CRITICAL(&_mux);
+    _unlink(var);
+    portEXIT_CRITICAL(&_mux);
+
+    xSemaphoreGive(_spaces);
+    return true;
+  }
+
+  bool peek(T& var) {
+    portENTER_CRITICAL(&_mux);
+    const bool available = _bitmap != 0;
+    if (available) var = _storage[_head[_highestLevel()]];
+    portEXIT_CRITICAL(&_mux);
+
+    return available;
+  }
+
+  bool addFromISR(const T& item, const uint8_t level, BaseType_t& task_woken) {
+    if (level >= LEVELS || !xSemaphoreTakeFromISR(_spaces, &task_woken)) return false;
+
+    portENTER_CRITICAL_ISR(&_mux);
+    _link(item, level, false);
+    portEXIT_CRITICAL_ISR(&_mux);
+
+    xSemaphoreGiveFromISR(_handle, &task_woken);
+    return true;
+  }
+
+  bool pushFromISR(const T& item, const uint8_t level, BaseType_t& task_woken) {
+    if (level >= LEVELS || !xSemaphoreTakeFromISR(_spaces, &task_woken)) return false;
+
+    portENTER_CRITICAL_ISR(&_mux);
+    _link(item, level, true);
+    portEXIT_CRITICAL_ISR(&_mux);
+
+    xSemaphoreGiveFromISR(_handle, &task_woken);
+    return true;
+  }
+
+  bool popFromISR(T& var, BaseType_t& task_woken) {
+    if (!xSemaphoreTakeFromISR(_handle, &task_woken)) return false;
+
+    portENTER_CRITICAL_ISR(&_mux);
+    _unlink(var);
+    portEXIT_CRITICAL_ISR(&_mux);
+
+    xSemaphoreGiveFromISR(_spaces, &task_woken);
+    return true;
+  }
+
+  bool peekFromISR(T& var) {
+    portENTER_CRITICAL_ISR(&_mux);
+    const bool available = _bitmap != 0;
+    if (available) var = _storage[_head[_highestLevel()]];
+    portEXIT_CRITICAL_ISR(&_mux);
+
+    return available;
+  }
+
+  explicit operator bool() const { return _handle != nullptr && _spaces != nullptr; }
+
+  private:
+  static constexpr uint16_t EMPTY = 0xffff;
+
+  uint8_t _highestLevel() const { return 31 - __builtin_clz(_bitmap); }
+
+  // Both must be called inside the critical section, after the semaphores granted a slot/an item
+  void _link(const T& item, const uint8_t level, const bool front) {
+    const uint16_t slot = _free;
+    _free               = _next[slot];
+    _storage[slot]      = item;
+
+    if (_head[level] == EMPTY) {
+      _next[slot]  = EMPTY;
+      _head[level] = _tail[level] = slot;
+    } else if (front) {
+      _next[slot]  = _head[level];
+      _head[level] = slot;
+    } else {
+      _next[slot]         = EMPTY;
+      _next[_tail[level]] = slot;
+      _tail[level]        = slot;
+    }
+
+    _bitmap |= 1UL << level;
+  }
+
+  void _unlink(T& var) {
+    const uint8_t level = _highestLevel();
+    const uint16_t slot = _head[level];
+
+    var          = _storage[slot];
+    _head[level] = _next[slot];
+
+    if (_head[level] == EMPTY) {
+      _tail[level] = EMPTY;
+      _bitmap &= ~(1UL << level);
+    }
+
+    _next[slot] = _free;
+    _free       = slot;
+  }
+
+  StaticSemaphore_t _items_tcb;
+  StaticSemaphore_t _spaces_tcb;
+  SemaphoreHandle_t _spaces;
+  portMUX_TYPE _mux;
+  uint32_t _bitmap;
+  uint16_t _free;
+  uint16_t _head[LEVELS];
+  uint16_t _tail[LEVELS];
+  uint16_t _next[LENGTH];
+  T _storage[LENGTH];
+};
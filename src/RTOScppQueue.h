@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include "RTOScppMemory.h"
+#include "RTOScppTrace.h"
 #include <Arduino.h>
 #include <freertos/queue.h>
 
@@ -26,7 +28,7 @@ class QueueInterface {
 
   public:
   virtual ~QueueInterface() {
-    if (_handle) vTaskDelete(_handle);
+    if (_handle) vQueueDelete(_handle);
   }
 
   QueueInterface(const QueueInterface&)                = delete;
@@ -62,19 +64,31 @@ class _QueueBase : public QueueInterface {
 
   public:
   bool push(const T& item, const TickType_t ticks_to_wait = portMAX_DELAY) const {
-    return xQueueSendToFront(_handle, &item, ticks_to_wait);
+    RTOSCPP_TRACE_BEGIN();
+    const bool result = xQueueSendToFront(_handle, &item, ticks_to_wait);
+    RTOSCPP_TRACE_END(this, TraceOp::QueuePush, result);
+    return result;
   }
 
   bool add(const T& item, const TickType_t ticks_to_wait = portMAX_DELAY) const {
-    return xQueueSendToBack(_handle, &item, ticks_to_wait);
+    RTOSCPP_TRACE_BEGIN();
+    const bool result = xQueueSendToBack(_handle, &item, ticks_to_wait);
+    RTOSCPP_TRACE_END(this, TraceOp::QueueAdd, result);
+    return result;
   }
 
   bool pop(T& var, const TickType_t ticks_to_wait = portMAX_DELAY) const {
-    return xQueueReceive(_handle, &var, ticks_to_wait);
+    RTOSCPP_TRACE_BEGIN();
+    const bool result = xQueueReceive(_handle, &var, ticks_to_wait);
+    RTOSCPP_TRACE_END(this, TraceOp::QueuePop, result);
+    return result;
   }
 
   bool peek(T& var, const TickType_t ticks_to_wait = 0) const {
-    return xQueuePeek(_handle, &var, ticks_to_wait);
+    RTOSCPP_TRACE_BEGIN();
+    const bool result = xQueuePeek(_handle, &var, ticks_to_wait);
+    RTOSCPP_TRACE_END(this, TraceOp::QueuePeek, result);
+    return result;
   }
 
   bool pushFromISR(const T& item, BaseType_t& task_woken) const {
@@ -90,6 +104,93 @@ class _QueueBase : public QueueInterface {
   }
 
   bool peekFromISR(T& var) const { return xQueuePeekFromISR(_handle, &var); }
+
+  // Replaces the item of a queue of length 1 (a mailbox), never blocks
+  bool overwrite(const T& item) const {
+    RTOSCPP_TRACE_BEGIN();
+    const bool result = xQueueOverwrite(_handle, &item);
+    RTOSCPP_TRACE_END(this, TraceOp::QueueAdd, result);
+    return result;
+  }
+
+  bool overwriteFromISR(const T& item, BaseType_t& task_woken) const {
+    return xQueueOverwriteFromISR(_handle, &item, &task_woken);
+  }
+
+  // Adds to the back without blocking, discarding the oldest items while the queue is full. The
+  // discarded items are added to dropped when given, the caller owns the counter.
+  //
+  // Not for queues in a queue set: each discarded item leaves a stale event in the set, which can
+  // then overflow. Asserted when queue sets are enabled
+  bool addLossy(const T& item, uint32_t* const dropped = nullptr) const {
+    _assertNotInSet();
+
+    RTOSCPP_TRACE_BEGIN();
+    uint8_t oldest[sizeof(T)];
+    bool result;
+
+    while (!(result = xQueueSendToBack(_handle, &item, 0))) {
+      if (!xQueueReceive(_handle, oldest, 0)) break;
+      if (dropped) (*dropped)++;
+    }
+
+    RTOSCPP_TRACE_END(this, TraceOp::QueueAdd, result);
+    return result;
+  }
+
+  bool addLossyFromISR(const T& item, BaseType_t& task_woken,
+                       uint32_t* const dropped = nullptr) const {
+    _assertNotInSet();
+
+    uint8_t oldest[sizeof(T)];
+
+    while (!xQueueSendToBackFromISR(_handle, &item, &task_woken)) {
+      if (!xQueueReceiveFromISR(_handle, oldest, &task_woken)) return false;
+      if (dropped) (*dropped)++;
+    }
+
+    return true;
+  }
+
+  // Blocks only for the first item, the rest are moved while space/items are available.
+  // Returns the number of items moved
+  uint32_t addMany(const T* const items, const uint32_t n,
+                   const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    if (n == 0 || !xQueueSendToBack(_handle, &items[0], ticks_to_wait)) return 0;
+
+    uint32_t count = 1;
+    while (count < n && xQueueSendToBack(_handle, &items[count], 0)) count++;
+    return count;
+  }
+
+  uint32_t popMany(T* const items, const uint32_t max_n,
+                   const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    if (max_n == 0 || !xQueueReceive(_handle, &items[0], ticks_to_wait)) return 0;
+
+    uint32_t count = 1;
+    while (count < max_n && xQueueReceive(_handle, &items[count], 0)) count++;
+    return count;
+  }
+
+  uint32_t addManyFromISR(const T* const items, const uint32_t n, BaseType_t& task_woken) const {
+    uint32_t count = 0;
+    while (count < n && xQueueSendToBackFromISR(_handle, &items[count], &task_woken)) count++;
+    return count;
+  }
+
+  uint32_t popManyFromISR(T* const items, const uint32_t max_n, BaseType_t& task_woken) const {
+    uint32_t count = 0;
+    while (count < max_n && xQueueReceiveFromISR(_handle, &items[count], &task_woken)) count++;
+    return count;
+  }
+
+  private:
+  // StaticQueue_t mirrors the private queue struct, its pvDummy7 is the queue set container
+  void _assertNotInSet() const {
+#if configUSE_QUEUE_SETS
+    configASSERT(reinterpret_cast<const StaticQueue_t*>(_handle)->pvDummy7 == nullptr);
+#endif
+  }
 };
 
 template <typename T>
@@ -102,6 +203,10 @@ class QueueDynamic : public _QueueBase<T> {
 template <typename T, uint32_t LENGTH>
 class QueueStatic : public _QueueBase<T> {
   public:
+  static constexpr uint32_t storageBytes() { return LENGTH * sizeof(T); }
+  static constexpr uint32_t controlBlockBytes() { return sizeof(QueueStatic) - storageBytes(); }
+  static constexpr uint32_t capacityItems() { return LENGTH; }
+
   QueueStatic()
       : _QueueBase<T>(xQueueCreateStatic(LENGTH, sizeof(T), _storage, &this->_tcb)) {}
 
@@ -123,4 +228,36 @@ class QueueExternalStorage : public _QueueBase<T> {
 
   private:
   StaticQueue_t _tcb;
+};
+
+// Like QueueStatic, with the storage placed according to MEMORY (see RTOScppMemory.h). The control
+// block is allocated from the internal heap on construction, it is not part of the object.
+// Evaluates to false if either allocation failed
+template <typename T, uint32_t LENGTH, typename MEMORY = MemoryInternal>
+class QueuePlaced : public _QueueBase<T> {
+  public:
+  static constexpr uint32_t storageBytes() { return LENGTH * sizeof(T); }
+  static constexpr uint32_t controlBlockBytes() {
+    return sizeof(QueuePlaced) + sizeof(StaticQueue_t);
+  }
+  static constexpr uint32_t capacityItems() { return LENGTH; }
+
+  QueuePlaced()
+      : _QueueBase<T>(nullptr)
+      , _tcb(sizeof(StaticQueue_t))
+      , _storage(LENGTH * sizeof(T)) {
+    if (!_tcb || !_storage) return;
+    this->_handle = xQueueCreateStatic(
+      LENGTH, sizeof(T), _storage.template as<uint8_t>(), _tcb.template as<StaticQueue_t>());
+  }
+
+  // The queue must be deleted before its memory is released
+  ~QueuePlaced() {
+    if (this->_handle) vQueueDelete(this->_handle);
+    this->_handle = nullptr;
+  }
+
+  private:
+  _ControlBlock _tcb;
+  _MemoryBlock<MEMORY::CAPS> _storage;
 };
\ No newline at end of file
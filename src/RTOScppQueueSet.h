@@ -10,6 +10,7 @@
 #include "RTOScppQueue.h"
 #include "RTOScppRingBuffer.h"
 #include <Arduino.h>
+#include <tuple>
 
 class QueueSet {
   public:
@@ -31,12 +32,22 @@ class QueueSet {
     return xRingbufferAddToQueueSetRead(ring_buffer._handle, _handle);
   }
 
+  template <typename Derived>
+  bool add(LockCRTP<Derived>& lock) const {
+    return xQueueAddToSet(lock.getHandle(), _handle);
+  }
+
   bool remove(LockInterface& lock) const { return xQueueRemoveFromSet(lock._handle, _handle); }
   bool remove(QueueInterface& queue) const { return xQueueRemoveFromSet(queue._handle, _handle); }
   bool remove(RingBufferInterface& ring_buffer) const {
     return xRingbufferRemoveFromQueueSetRead(ring_buffer._handle, _handle);
   }
 
+  template <typename Derived>
+  bool remove(LockCRTP<Derived>& lock) const {
+    return xQueueRemoveFromSet(lock.getHandle(), _handle);
+  }
+
   QueueSetMemberHandle_t select(const TickType_t ticks_to_wait = portMAX_DELAY) const {
     return xQueueSelectFromSet(_handle, ticks_to_wait);
   }
@@ -46,4 +57,276 @@ class QueueSet {
 
   private:
   QueueSetHandle_t _handle;
+};
+
+// Number of events a member can post to a queue set. Specialize it for members whose capacity is
+// only known at runtime (dynamic queues, counting semaphores) to use them in QueueSetStatic
+template <typename M>
+struct QueueSetEvents;
+
+template <typename T, uint32_t LENGTH>
+struct QueueSetEvents<QueueStatic<T, LENGTH>> {
+  static constexpr uint32_t value = LENGTH;
+};
+
+// Binary semaphores and mutexes hold a single event
+template <>
+struct QueueSetEvents<SemaphoreBinaryStatic> {
+  static constexpr uint32_t value = 1;
+};
+
+template <>
+struct QueueSetEvents<SemaphoreBinaryDynamic> {
+  static constexpr uint32_t value = 1;
+};
+
+template <>
+struct QueueSetEvents<MutexStatic> {
+  static constexpr uint32_t value = 1;
+};
+
+template <>
+struct QueueSetEvents<MutexDynamic> {
+  static constexpr uint32_t value = 1;
+};
+
+template <>
+struct QueueSetEvents<SemaphoreBinaryStaticCRTP> {
+  static constexpr uint32_t value = 1;
+};
+
+template <>
+struct QueueSetEvents<MutexStaticCRTP> {
+  static constexpr uint32_t value = 1;
+};
+
+// Ring buffers join the set through their binary read semaphore
+template <typename T, uint32_t LENGTH>
+struct QueueSetEvents<RingBufferNoSplitStatic<T, LENGTH>> {
+  static constexpr uint32_t value = 1;
+};
+
+template <typename T>
+struct QueueSetEvents<RingBufferNoSplitDynamic<T>> {
+  static constexpr uint32_t value = 1;
+};
+
+template <typename T>
+struct QueueSetEvents<RingBufferNoSplitExternalStorage<T>> {
+  static constexpr uint32_t value = 1;
+};
+
+template <typename T, uint32_t LENGTH>
+struct QueueSetEvents<RingBufferSplitStatic<T, LENGTH>> {
+  static constexpr uint32_t value = 1;
+};
+
+template <typename T>
+struct QueueSetEvents<RingBufferSplitDynamic<T>> {
+  static constexpr uint32_t value = 1;
+};
+
+template <typename T>
+struct QueueSetEvents<RingBufferSplitExternalStorage<T>> {
+  static constexpr uint32_t value = 1;
+};
+
+template <typename T, uint32_t LENGTH>
+struct QueueSetEvents<RingBufferByteStatic<T, LENGTH>> {
+  static constexpr uint32_t value = 1;
+};
+
+template <typename T>
+struct QueueSetEvents<RingBufferByteDynamic<T>> {
+  static constexpr uint32_t value = 1;
+};
+
+template <typename T>
+struct QueueSetEvents<RingBufferByteExternalStorage<T>> {
+  static constexpr uint32_t value = 1;
+};
+
+template <typename... Members>
+struct _QueueSetLength;
+
+template <>
+struct _QueueSetLength<> {
+  static constexpr uint32_t value = 0;
+};
+
+template <typename M, typename... Members>
+struct _QueueSetLength<M, Members...> {
+  static constexpr uint32_t value = QueueSetEvents<M>::value + _QueueSetLength<Members...>::value;
+};
+
+constexpr uint32_t _nextPowerOfTwo(const uint32_t value, const uint32_t power = 1) {
+  return power >= value ? power : _nextPowerOfTwo(value, power * 2);
+}
+
+// Queue set whose length and storage are computed from the member types. Members are added on
+// construction, and the selected member is dispatched to its handler through a hash table of
+// handles instead of comparing it against every member. The handler must read the member (pop,
+// take, receive) so its event is consumed
+template <typename... Members>
+class QueueSetStatic {
+  static_assert(sizeof...(Members) > 0, "QueueSetStatic needs at least one member");
+  static_assert(sizeof...(Members) < 255, "Too many members");
+
+  public:
+  template <uint32_t INDEX>
+  using Member = typename std::tuple_element<INDEX, std::tuple<Members...>>::type;
+
+  static constexpr uint32_t LENGTH     = _QueueSetLength<Members...>::value;
+  static constexpr uint32_t MEMBERS    = sizeof...(Members);
+  static constexpr uint32_t TABLE_SIZE = _nextPowerOfTwo(2 * MEMBERS);
+
+  static constexpr uint32_t storageBytes() { return LENGTH * sizeof(QueueSetMemberHandle_t); }
+  static constexpr uint32_t controlBlockBytes() { return sizeof(QueueSetStatic) - storageBytes(); }
+  static constexpr uint32_t capacityItems() { return LENGTH; }
+
+  QueueSetStatic(Members&... members)
+      : _handle(xQueueGenericCreateStatic(
+          LENGTH, sizeof(QueueSetMemberHandle_t), _storage, &_tcb, queueQUEUE_TYPE_SET))
+      , _members{_makeMember(members)...}
+      , _table{}
+      , _added(0) {
+    if (_handle == nullptr) return;
+
+    for (uint32_t i = 0; i < MEMBERS; i++) {
+      const bool added = _members[i].ring_buffer
+                         ? xRingbufferAddToQueueSetRead(_members[i].ring_buffer, _handle)
+                         : xQueueAddToSet(_members[i].handle, _handle);
+      if (!added) continue;
+
+      _added++;
+      if (_members[i].handle) _insert(i);
+    }
+  }
+
+  // Members are removed before the set is deleted, so they don't keep pointing to it. FreeRTOS only
+  // removes a member that is empty
+  ~QueueSetStatic() {
+    if (_handle == nullptr) return;
+
+    for (uint32_t i = 0; i < MEMBERS; i++) {
+      if (_members[i].ring_buffer) {
+        xRingbufferRemoveFromQueueSetRead(_members[i].ring_buffer, _handle);
+      } else {
+        xQueueRemoveFromSet(_members[i].handle, _handle);
+      }
+    }
+
+    vQueueDelete(_handle);
+  }
+
+  QueueSetStatic(const QueueSetStatic&)                = delete;
+  QueueSetStatic& operator=(const QueueSetStatic&)     = delete;
+  QueueSetStatic(QueueSetStatic&&) noexcept            = delete;
+  QueueSetStatic& operator=(QueueSetStatic&&) noexcept = delete;
+
+  template <uint32_t INDEX>
+  void setHandler(void (*handler)(Member<INDEX>&, void*), void* arg = nullptr) {
+    static_assert(INDEX < MEMBERS, "Member index out of range");
+    _members[INDEX].handler = reinterpret_cast<_Handler>(handler);
+    _members[INDEX].arg     = arg;
+  }
+
+  // Returns the index of the selected member, or -1 on timeout
+  int32_t selectIndex(const TickType_t ticks_to_wait = portMAX_DELAY) {
+    const QueueSetMemberHandle_t member = xQueueSelectFromSet(_handle, ticks_to_wait);
+    return member ? _find(member) : -1;
+  }
+
+  // Waits for a member and runs its handler. Returns false on timeout or if the member has no
+  // handler
+  bool dispatch(const TickType_t ticks_to_wait = portMAX_DELAY) {
+    const int32_t index = selectIndex(ticks_to_wait);
+    if (index < 0) return false;
+
+    const _Member& member = _members[index];
+    if (member.handler == nullptr) return false;
+
+    member.invoke(member.object, member.handler, member.arg);
+    return true;
+  }
+
+  QueueSetHandle_t getHandle() const { return _handle; }
+
+  explicit operator bool() const { return _handle != nullptr && _added == MEMBERS; }
+
+  private:
+  typedef void (*_Handler)();
+  typedef void (*_Invoker)(void* object, _Handler handler, void* arg);
+
+  struct _Member {
+    void* object;
+    QueueSetMemberHandle_t handle;
+    RingbufHandle_t ring_buffer;
+    _Invoker invoke;
+    _Handler handler;
+    void* arg;
+  };
+
+  template <typename M>
+  static void _invoke(void* object, _Handler handler, void* arg) {
+    reinterpret_cast<void (*)(M&, void*)>(handler)(*static_cast<M*>(object), arg);
+  }
+
+  static void _setHandle(_Member& member, QueueInterface& queue) {
+    member.handle = queue.getHandle();
+  }
+
+  static void _setHandle(_Member& member, LockInterface& lock) { member.handle = lock.getHandle(); }
+
+  template <typename Derived>
+  static void _setHandle(_Member& member, LockCRTP<Derived>& lock) {
+    member.handle = lock.getHandle();
+  }
+
+  // The handle selected for a ring buffer is its internal read semaphore, learned on first select
+  static void _setHandle(_Member& member, RingBufferInterface& ring_buffer) {
+    member.ring_buffer = ring_buffer.getHandle();
+  }
+
+  template <typename M>
+  static _Member _makeMember(M& object) {
+    _Member member = {&object, nullptr, nullptr, &_invoke<M>, nullptr, nullptr};
+    _setHandle(member, object);
+    return member;
+  }
+
+  static uint32_t _hash(const QueueSetMemberHandle_t handle) {
+    return ((uintptr_t)handle >> 2) & (TABLE_SIZE - 1);
+  }
+
+  void _insert(const uint32_t index) {
+    uint32_t slot = _hash(_members[index].handle);
+    while (_table[slot] != 0) slot = (slot + 1) & (TABLE_SIZE - 1);
+    _table[slot] = index + 1;
+  }
+
+  int32_t _find(const QueueSetMemberHandle_t handle) {
+    for (uint32_t slot = _hash(handle); _table[slot] != 0; slot = (slot + 1) & (TABLE_SIZE - 1)) {
+      const uint32_t index = _table[slot] - 1;
+      if (_members[index].handle == handle) return index;
+    }
+
+    for (uint32_t i = 0; i < MEMBERS; i++) {
+      if (_members[i].ring_buffer && _members[i].handle == nullptr &&
+          xRingbufferCanRead(_members[i].ring_buffer, handle)) {
+        _members[i].handle = handle;
+        _insert(i);
+        return i;
+      }
+    }
+
+    return -1;
+  }
+
+  StaticQueue_t _tcb;
+  uint8_t _storage[LENGTH * sizeof(QueueSetMemberHandle_t)];
+  QueueSetHandle_t _handle;
+  _Member _members[MEMBERS];
+  uint8_t _table[TABLE_SIZE];
+  uint32_t _added;
 };
\ No newline at end of file
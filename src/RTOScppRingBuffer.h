@@ -6,12 +6,20 @@
 
 #pragma once
 
+#include "RTOScppMemory.h"
+#include "RTOScppTrace.h"
 #include <Arduino.h>
 #include <freertos/ringbuf.h>
 
 // Forward declaration of QueueSet
 class QueueSet;
 
+// Bytes taken by an item in a no-split or split ring buffer: its size aligned to 4 bytes plus the
+// 8 byte item header
+constexpr uint32_t ringBufferItemBytes(const uint32_t item_size) {
+  return 4 * ((item_size + 3) / 4) + 8;
+}
+
 class RingBufferInterface {
   private:
   friend class QueueSet;
@@ -34,6 +42,8 @@ class RingBufferInterface {
   RingBufferInterface(RingBufferInterface&&) noexcept            = delete;
   RingBufferInterface& operator=(RingBufferInterface&&) noexcept = delete;
 
+  RingbufHandle_t getHandle() const { return _handle; }
+
   explicit operator bool() const { return _handle != nullptr; }
 };
 
@@ -42,6 +52,157 @@ inline bool operator==(const QueueSetMemberHandle_t& queue_set_member,
   return xRingbufferCanRead(ring_buffer._handle, queue_set_member);
 }
 
+// Owns an item received from a ring buffer and returns it on destruction. Use releaseFromISR() when
+// the item is handled inside an ISR
+template <typename T>
+class RingBufferItem {
+  public:
+  RingBufferItem()
+      : _handle(nullptr)
+      , _item(nullptr)
+      , _size(0) {}
+
+  RingBufferItem(const RingbufHandle_t handle, T* const item, const uint32_t size)
+      : _handle(handle)
+      , _item(item)
+      , _size(item ? size : 0) {}
+
+  ~RingBufferItem() { release(); }
+
+  RingBufferItem(const RingBufferItem&)            = delete;
+  RingBufferItem& operator=(const RingBufferItem&) = delete;
+
+  RingBufferItem(RingBufferItem&& other) noexcept
+      : _handle(other._handle)
+      , _item(other._item)
+      , _size(other._size) {
+    other._item = nullptr;
+    other._size = 0;
+  }
+
+  RingBufferItem& operator=(RingBufferItem&& other) noexcept {
+    if (this != &other) {
+      release();
+      _handle     = other._handle;
+      _item       = other._item;
+      _size       = other._size;
+      other._item = nullptr;
+      other._size = 0;
+    }
+    return *this;
+  }
+
+  void release() {
+    if (_item == nullptr) return;
+    vRingbufferReturnItem(_handle, (void*)_item);
+    _item = nullptr;
+    _size = 0;
+  }
+
+  void releaseFromISR(BaseType_t& task_woken) {
+    if (_item == nullptr) return;
+    vRingbufferReturnItemFromISR(_handle, (void*)_item, &task_woken);
+    _item = nullptr;
+    _size = 0;
+  }
+
+  T* get() const { return _item; }
+  uint32_t size() const { return _size; }
+
+  T& operator*() const { return *_item; }
+  T* operator->() const { return _item; }
+
+  explicit operator bool() const { return _item != nullptr; }
+
+  private:
+  RingbufHandle_t _handle;
+  T* _item;
+  uint32_t _size;
+};
+
+// Owns both parts of an item received from a split ring buffer. The tail is nullptr when the item
+// was not split
+template <typename T>
+class RingBufferSplitItem {
+  public:
+  RingBufferSplitItem()
+      : _handle(nullptr)
+      , _head(nullptr)
+      , _tail(nullptr)
+      , _head_size(0)
+      , _tail_size(0) {}
+
+  RingBufferSplitItem(const RingbufHandle_t handle, T* const head, T* const tail,
+                      const uint32_t head_size, const uint32_t tail_size)
+      : _handle(handle)
+      , _head(head)
+      , _tail(tail)
+      , _head_size(head ? head_size : 0)
+      , _tail_size(tail ? tail_size : 0) {}
+
+  ~RingBufferSplitItem() { release(); }
+
+  RingBufferSplitItem(const RingBufferSplitItem&)            = delete;
+  RingBufferSplitItem& operator=(const RingBufferSplitItem&) = delete;
+
+  RingBufferSplitItem(RingBufferSplitItem&& other) noexcept
+      : _handle(other._handle)
+      , _head(other._head)
+      , _tail(other._tail)
+      , _head_size(other._head_size)
+      , _tail_size(other._tail_size) {
+    other._head = other._tail = nullptr;
+    other._head_size = other._tail_size = 0;
+  }
+
+  RingBufferSplitItem& operator=(RingBufferSplitItem&& other) noexcept {
+    if (this != &other) {
+      release();
+      _handle     = other._handle;
+      _head       = other._head;
+      _tail       = other._tail;
+      _head_size  = other._head_size;
+      _tail_size  = other._tail_size;
+      other._head = other._tail = nullptr;
+      other._head_size = other._tail_size = 0;
+    }
+    return *this;
+  }
+
+  void release() {
+    if (_head) vRingbufferReturnItem(_handle, (void*)_head);
+    if (_tail) vRingbufferReturnItem(_handle, (void*)_tail);
+    _head = _tail = nullptr;
+    _head_size = _tail_size = 0;
+  }
+
+  void releaseFromISR(BaseType_t& task_woken) {
+    if (_head) vRingbufferReturnItemFromISR(_handle, (void*)_head, &task_woken);
+    if (_tail) vRingbufferReturnItemFromISR(_handle, (void*)_tail, &task_woken);
+    _head = _tail = nullptr;
+    _head_size = _tail_size = 0;
+  }
+
+  T* head() const { return _head; }
+  T* tail() const { return _tail; }
+  uint32_t headSize() const { return _head_size; }
+  uint32_t tailSize() const { return _tail_size; }
+  uint32_t size() const { return _head_size + _tail_size; }
+  bool isSplit() const { return _tail != nullptr; }
+
+  explicit operator bool() const { return _head != nullptr; }
+
+  private:
+  RingbufHandle_t _handle;
+  T* _head;
+  T* _tail;
+  uint32_t _head_size;
+  uint32_t _tail_size;
+};
+
+// The lossy sends and queue set membership are mutually exclusive: each discarded item leaves a
+// stale event in the set, which can then overflow. The IDF doesn't expose the set of a ring buffer,
+// so unlike QueueInterface this isn't asserted
 template <typename T>
 class RingBufferBase : public RingBufferInterface {
   protected:
@@ -49,10 +210,30 @@ class RingBufferBase : public RingBufferInterface {
       : RingBufferInterface(handle) {}
   virtual ~RingBufferBase() {}
 
+  // Retries send() without blocking, discarding the oldest data through evict() while it fails.
+  // evict() returns what it discarded, 0 when there was nothing left to discard, and it is added
+  // to dropped when given
+  template <typename SEND, typename EVICT>
+  bool _sendLossy(const uint32_t item_size, uint32_t* const dropped, const SEND& send,
+                  const EVICT& evict) const {
+    if (item_size > xRingbufferGetMaxItemSize(_handle)) return false;
+
+    while (!send()) {
+      const uint32_t evicted = evict();
+      if (evicted == 0) return false;
+      if (dropped) *dropped += evicted;
+    }
+
+    return true;
+  }
+
   public:
   bool send(const T* const item, const uint32_t item_size,
             const TickType_t ticks_to_wait = portMAX_DELAY) const {
-    return xRingbufferSend(_handle, (void*)item, item_size, ticks_to_wait);
+    RTOSCPP_TRACE_BEGIN();
+    const bool result = xRingbufferSend(_handle, (void*)item, item_size, ticks_to_wait);
+    RTOSCPP_TRACE_END(this, TraceOp::RingBufferSend, result);
+    return result;
   }
 
   bool sendFromISR(const T* const item, const uint32_t item_size,
@@ -82,13 +263,75 @@ class RingBufferNoSplitBase : public RingBufferBase<T> {
   T* receiveFromISR(uint32_t& item_size) {
     return (T*)xRingbufferReceiveFromISR(this->_handle, &item_size);
   }
+
+  RingBufferItem<T> receiveItem(const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    size_t item_size = 0;
+    T* item          = (T*)xRingbufferReceive(this->_handle, &item_size, ticks_to_wait);
+    return RingBufferItem<T>(this->_handle, item, item_size);
+  }
+
+  RingBufferItem<T> receiveItemFromISR() const {
+    size_t item_size = 0;
+    T* item          = (T*)xRingbufferReceiveFromISR(this->_handle, &item_size);
+    return RingBufferItem<T>(this->_handle, item, item_size);
+  }
+
+  // Reserves space for an item inside the ring buffer to be filled in place. The item is not
+  // available to readers until commit() is called. Returns nullptr if there is no space
+  T* acquire(const uint32_t item_size, const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    void* item = nullptr;
+    if (!xRingbufferSendAcquire(this->_handle, &item, item_size, ticks_to_wait)) return nullptr;
+    return (T*)item;
+  }
+
+  bool commit(T* const item) const { return xRingbufferSendComplete(this->_handle, (void*)item); }
+
+  // Sends without blocking, discarding the oldest items until the new one fits, the discarded items
+  // are added to dropped when given. Fails if the item can never fit or the space is held by items
+  // not yet returned. Not for ring buffers in a queue set, see RingBufferBase
+  bool sendLossy(const T* const item, const uint32_t item_size,
+                 uint32_t* const dropped = nullptr) const {
+    const RingbufHandle_t handle = this->_handle;
+
+    RTOSCPP_TRACE_BEGIN();
+    const bool result = this->_sendLossy(
+      item_size, dropped,
+      [=]() { return xRingbufferSend(handle, (void*)item, item_size, 0); },
+      [=]() -> uint32_t {
+        size_t size  = 0;
+        void* oldest = xRingbufferReceive(handle, &size, 0);
+        if (oldest == nullptr) return 0;
+        vRingbufferReturnItem(handle, oldest);
+        return 1;
+      });
+    RTOSCPP_TRACE_END(this, TraceOp::RingBufferSend, result);
+    return result;
+  }
+
+  bool sendLossyFromISR(const T* const item, const uint32_t item_size,
+                        BaseType_t& higher_priority_task_woken,
+                        uint32_t* const dropped = nullptr) const {
+    const RingbufHandle_t handle = this->_handle;
+    BaseType_t* const woken      = &higher_priority_task_woken;
+
+    return this->_sendLossy(
+      item_size, dropped,
+      [=]() { return xRingbufferSendFromISR(handle, (void*)item, item_size, woken); },
+      [=]() -> uint32_t {
+        size_t size  = 0;
+        void* oldest = xRingbufferReceiveFromISR(handle, &size);
+        if (oldest == nullptr) return 0;
+        vRingbufferReturnItemFromISR(handle, oldest, woken);
+        return 1;
+      });
+  }
 };
 
 template <typename T>
 class RingBufferNoSplitDynamic : public RingBufferNoSplitBase<T> {
   public:
   // Size aligned to nearest 4 bytes + 8 bytes per item
-  static constexpr uint32_t ALIGNED_SIZE = 4 * ((sizeof(T) + 3) / 4) + 8;
+  static constexpr uint32_t ALIGNED_SIZE = ringBufferItemBytes(sizeof(T));
 
   RingBufferNoSplitDynamic(const uint32_t length)
       : RingBufferNoSplitBase<T>(xRingbufferCreate(length * ALIGNED_SIZE, RINGBUF_TYPE_NOSPLIT)) {}
@@ -98,7 +341,17 @@ template <typename T, uint32_t LENGTH>
 class RingBufferNoSplitStatic : public RingBufferNoSplitBase<T> {
   public:
   // Size aligned to nearest 4 bytes + 8 bytes per item
-  static constexpr uint32_t ALIGNED_SIZE = 4 * ((sizeof(T) + 3) / 4) + 8;
+  static constexpr uint32_t ALIGNED_SIZE = ringBufferItemBytes(sizeof(T));
+
+  static constexpr uint32_t storageBytes() { return LENGTH * ALIGNED_SIZE; }
+  static constexpr uint32_t controlBlockBytes() {
+    return sizeof(RingBufferNoSplitStatic) - storageBytes();
+  }
+
+  // Items of avg_size bytes that fit at once
+  static constexpr uint32_t capacityItems(const uint32_t avg_size = sizeof(T)) {
+    return storageBytes() / ringBufferItemBytes(avg_size);
+  }
 
   RingBufferNoSplitStatic()
       : RingBufferNoSplitBase<T>(
@@ -109,11 +362,51 @@ class RingBufferNoSplitStatic : public RingBufferNoSplitBase<T> {
   uint8_t _storage[LENGTH * ALIGNED_SIZE];
 };
 
+// Like RingBufferNoSplitStatic, with the storage placed according to MEMORY (see RTOScppMemory.h).
+// The control block is allocated from the internal heap on construction, it is not part of the
+// object. Evaluates to false if either allocation failed
+template <typename T, uint32_t LENGTH, typename MEMORY = MemoryInternal>
+class RingBufferNoSplitPlaced : public RingBufferNoSplitBase<T> {
+  public:
+  // Size aligned to nearest 4 bytes + 8 bytes per item
+  static constexpr uint32_t ALIGNED_SIZE = ringBufferItemBytes(sizeof(T));
+
+  static constexpr uint32_t storageBytes() { return LENGTH * ALIGNED_SIZE; }
+  static constexpr uint32_t controlBlockBytes() {
+    return sizeof(RingBufferNoSplitPlaced) + sizeof(StaticRingbuffer_t);
+  }
+
+  // Items of avg_size bytes that fit at once
+  static constexpr uint32_t capacityItems(const uint32_t avg_size = sizeof(T)) {
+    return storageBytes() / ringBufferItemBytes(avg_size);
+  }
+
+  RingBufferNoSplitPlaced()
+      : RingBufferNoSplitBase<T>(nullptr)
+      , _tcb(sizeof(StaticRingbuffer_t))
+      , _storage(LENGTH * ALIGNED_SIZE) {
+    if (!_tcb || !_storage) return;
+    this->_handle = xRingbufferCreateStatic(LENGTH * ALIGNED_SIZE, RINGBUF_TYPE_NOSPLIT,
+                                            _storage.template as<uint8_t>(),
+                                            _tcb.template as<StaticRingbuffer_t>());
+  }
+
+  // The ring buffer must be deleted before its memory is released
+  ~RingBufferNoSplitPlaced() {
+    if (this->_handle) vRingbufferDelete(this->_handle);
+    this->_handle = nullptr;
+  }
+
+  private:
+  _ControlBlock _tcb;
+  _MemoryBlock<MEMORY::CAPS> _storage;
+};
+
 template <typename T>
 class RingBufferNoSplitExternalStorage : public RingBufferNoSplitBase<T> {
   public:
   // Size aligned to nearest 4 bytes + 8 bytes per item
-  static constexpr uint32_t ALIGNED_SIZE = 4 * ((sizeof(T) + 3) / 4) + 8;
+  static constexpr uint32_t ALIGNED_SIZE = ringBufferItemBytes(sizeof(T));
 
   RingBufferNoSplitExternalStorage()
       : RingBufferNoSplitBase<T>(nullptr) {}
@@ -144,13 +437,84 @@ class RingBufferSplitBase : public RingBufferBase<T> {
     return xRingbufferReceiveSplitFromISR(
       this->_handle, head, tail, &head_item_size, &tail_item_size);
   }
+
+  RingBufferSplitItem<T> receiveItem(const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    void* head       = nullptr;
+    void* tail       = nullptr;
+    size_t head_size = 0;
+    size_t tail_size = 0;
+
+    if (!xRingbufferReceiveSplit(this->_handle, &head, &tail, &head_size, &tail_size, ticks_to_wait))
+      return RingBufferSplitItem<T>();
+
+    return RingBufferSplitItem<T>(this->_handle, (T*)head, (T*)tail, head_size, tail_size);
+  }
+
+  RingBufferSplitItem<T> receiveItemFromISR() const {
+    void* head       = nullptr;
+    void* tail       = nullptr;
+    size_t head_size = 0;
+    size_t tail_size = 0;
+
+    if (!xRingbufferReceiveSplitFromISR(this->_handle, &head, &tail, &head_size, &tail_size))
+      return RingBufferSplitItem<T>();
+
+    return RingBufferSplitItem<T>(this->_handle, (T*)head, (T*)tail, head_size, tail_size);
+  }
+
+  // Sends without blocking, discarding the oldest items until the new one fits, the discarded items
+  // are added to dropped when given. Fails if the item can never fit or the space is held by items
+  // not yet returned. Not for ring buffers in a queue set, see RingBufferBase
+  bool sendLossy(const T* const item, const uint32_t item_size,
+                 uint32_t* const dropped = nullptr) const {
+    const RingbufHandle_t handle = this->_handle;
+
+    RTOSCPP_TRACE_BEGIN();
+    const bool result = this->_sendLossy(
+      item_size, dropped,
+      [=]() { return xRingbufferSend(handle, (void*)item, item_size, 0); },
+      [=]() -> uint32_t {
+        void* head       = nullptr;
+        void* tail       = nullptr;
+        size_t head_size = 0;
+        size_t tail_size = 0;
+        if (!xRingbufferReceiveSplit(handle, &head, &tail, &head_size, &tail_size, 0)) return 0;
+        vRingbufferReturnItem(handle, head);
+        if (tail) vRingbufferReturnItem(handle, tail);
+        return 1;
+      });
+    RTOSCPP_TRACE_END(this, TraceOp::RingBufferSend, result);
+    return result;
+  }
+
+  bool sendLossyFromISR(const T* const item, const uint32_t item_size,
+                        BaseType_t& higher_priority_task_woken,
+                        uint32_t* const dropped = nullptr) const {
+    const RingbufHandle_t handle = this->_handle;
+    BaseType_t* const woken      = &higher_priority_task_woken;
+
+    return this->_sendLossy(
+      item_size, dropped,
+      [=]() { return xRingbufferSendFromISR(handle, (void*)item, item_size, woken); },
+      [=]() -> uint32_t {
+        void* head       = nullptr;
+        void* tail       = nullptr;
+        size_t head_size = 0;
+        size_t tail_size = 0;
+        if (!xRingbufferReceiveSplitFromISR(handle, &head, &tail, &head_size, &tail_size))
+          return 0;
+        vRingbufferReturnItemFromISR(handle, head, woken);
+        if (tail) vRingbufferReturnItemFromISR(handle, tail, woken);
+        return 1;
+      });
+  }
 };
 
 template <typename T>
 class RingBufferSplitDynamic : public RingBufferSplitBase<T> {
   public:
   // Size aligned to nearest 4 bytes + 8 bytes per item
-  static constexpr uint32_t ALIGNED_SIZE = 4 * ((sizeof(T) + 3) / 4) + 8;
+  static constexpr uint32_t ALIGNED_SIZE = ringBufferItemBytes(sizeof(T));
 
   RingBufferSplitDynamic(const uint32_t length)
       : RingBufferSplitBase<T>(xRingbufferCreate(length * ALIGNED_SIZE, RINGBUF_TYPE_ALLOWSPLIT)) {}
@@ -160,7 +524,18 @@ template <typename T, uint32_t LENGTH>
 class RingBufferSplitStatic : public RingBufferSplitBase<T> {
   public:
   // Size aligned to nearest 4 bytes + 8 bytes per item
-  static constexpr uint32_t ALIGNED_SIZE = 4 * ((sizeof(T) + 3) / 4) + 8;
+  static constexpr uint32_t ALIGNED_SIZE = ringBufferItemBytes(sizeof(T));
+
+  static constexpr uint32_t storageBytes() { return LENGTH * ALIGNED_SIZE; }
+  static constexpr uint32_t controlBlockBytes() {
+    return sizeof(RingBufferSplitStatic) - storageBytes();
+  }
+
+  // Items of avg_size bytes that fit at once. An item split at the end of the buffer takes a second
+  // header, which is kept as margin
+  static constexpr uint32_t capacityItems(const uint32_t avg_size = sizeof(T)) {
+    return (storageBytes() - ringBufferItemBytes(0)) / ringBufferItemBytes(avg_size);
+  }
 
   RingBufferSplitStatic()
       : RingBufferSplitBase<T>(xRingbufferCreateStatic(LENGTH * ALIGNED_SIZE,
@@ -171,11 +546,52 @@ class RingBufferSplitStatic : public RingBufferSplitBase<T> {
   uint8_t _storage[LENGTH * ALIGNED_SIZE];
 };
 
+// Like RingBufferSplitStatic, with the storage placed according to MEMORY (see RTOScppMemory.h).
+// The control block is allocated from the internal heap on construction, it is not part of the
+// object. Evaluates to false if either allocation failed
+template <typename T, uint32_t LENGTH, typename MEMORY = MemoryInternal>
+class RingBufferSplitPlaced : public RingBufferSplitBase<T> {
+  public:
+  // Size aligned to nearest 4 bytes + 8 bytes per item
+  static constexpr uint32_t ALIGNED_SIZE = ringBufferItemBytes(sizeof(T));
+
+  static constexpr uint32_t storageBytes() { return LENGTH * ALIGNED_SIZE; }
+  static constexpr uint32_t controlBlockBytes() {
+    return sizeof(RingBufferSplitPlaced) + sizeof(StaticRingbuffer_t);
+  }
+
+  // Items of avg_size bytes that fit at once. An item split at the end of the buffer takes a second
+  // header, which is kept as margin
+  static constexpr uint32_t capacityItems(const uint32_t avg_size = sizeof(T)) {
+    return (storageBytes() - ringBufferItemBytes(0)) / ringBufferItemBytes(avg_size);
+  }
+
+  RingBufferSplitPlaced()
+      : RingBufferSplitBase<T>(nullptr)
+      , _tcb(sizeof(StaticRingbuffer_t))
+      , _storage(LENGTH * ALIGNED_SIZE) {
+    if (!_tcb || !_storage) return;
+    this->_handle = xRingbufferCreateStatic(LENGTH * ALIGNED_SIZE, RINGBUF_TYPE_ALLOWSPLIT,
+                                            _storage.template as<uint8_t>(),
+                                            _tcb.template as<StaticRingbuffer_t>());
+  }
+
+  // The ring buffer must be deleted before its memory is released
+  ~RingBufferSplitPlaced() {
+    if (this->_handle) vRingbufferDelete(this->_handle);
+    this->_handle = nullptr;
+  }
+
+  private:
+  _ControlBlock _tcb;
+  _MemoryBlock<MEMORY::CAPS> _storage;
+};
+
 template <typename T>
 class RingBufferSplitExternalStorage : public RingBufferSplitBase<T> {
   public:
   // Size aligned to nearest 4 bytes + 8 bytes per item
-  static constexpr uint32_t ALIGNED_SIZE = 4 * ((sizeof(T) + 3) / 4) + 8;
+  static constexpr uint32_t ALIGNED_SIZE = ringBufferItemBytes(sizeof(T));
 
   RingBufferSplitExternalStorage()
       : RingBufferSplitBase<T>(nullptr) {}
@@ -203,6 +619,65 @@ class RingBufferByteBase : public RingBufferBase<T> {
   T* receiveUpToFromISR(const uint32_t max_item_size, uint32_t& item_size) const {
     return (T*)xRingbufferReceiveUpToFromISR(this->_handle, &item_size, max_item_size);
   }
+
+  RingBufferItem<T> receiveItemUpTo(const uint32_t max_item_size,
+                                    const TickType_t ticks_to_wait = portMAX_DELAY) const {
+    size_t item_size = 0;
+    T* item = (T*)xRingbufferReceiveUpTo(this->_handle, &item_size, ticks_to_wait, max_item_size);
+    return RingBufferItem<T>(this->_handle, item, item_size);
+  }
+
+  RingBufferItem<T> receiveItemUpToFromISR(const uint32_t max_item_size) const {
+    size_t item_size = 0;
+    T* item = (T*)xRingbufferReceiveUpToFromISR(this->_handle, &item_size, max_item_size);
+    return RingBufferItem<T>(this->_handle, item, item_size);
+  }
+
+  // Sends without blocking, discarding the oldest bytes until the new ones fit, the discarded bytes
+  // are added to dropped when given. Not for ring buffers in a queue set, see RingBufferBase
+  bool sendLossy(const T* const item, const uint32_t item_size,
+                 uint32_t* const dropped = nullptr) const {
+    const RingbufHandle_t handle = this->_handle;
+
+    RTOSCPP_TRACE_BEGIN();
+    const bool result = this->_sendLossy(
+      item_size, dropped,
+      [=]() { return xRingbufferSend(handle, (void*)item, item_size, 0); },
+      [=]() -> uint32_t {
+        size_t size  = 0;
+        void* oldest = xRingbufferReceiveUpTo(handle, &size, 0, _evictBytes(handle, item_size));
+        if (oldest == nullptr) return 0;
+        vRingbufferReturnItem(handle, oldest);
+        return size;
+      });
+    RTOSCPP_TRACE_END(this, TraceOp::RingBufferSend, result);
+    return result;
+  }
+
+  bool sendLossyFromISR(const T* const item, const uint32_t item_size,
+                        BaseType_t& higher_priority_task_woken,
+                        uint32_t* const dropped = nullptr) const {
+    const RingbufHandle_t handle = this->_handle;
+    BaseType_t* const woken      = &higher_priority_task_woken;
+
+    return this->_sendLossy(
+      item_size, dropped,
+      [=]() { return xRingbufferSendFromISR(handle, (void*)item, item_size, woken); },
+      [=]() -> uint32_t {
+        size_t size  = 0;
+        void* oldest = xRingbufferReceiveUpToFromISR(handle, &size, _evictBytes(handle, item_size));
+        if (oldest == nullptr) return 0;
+        vRingbufferReturnItemFromISR(handle, oldest, woken);
+        return size;
+      });
+  }
+
+  private:
+  // Bytes missing for item_size to fit, at least 1
+  static uint32_t _evictBytes(const RingbufHandle_t handle, const uint32_t item_size) {
+    const uint32_t free = xRingbufferGetCurFreeSize(handle);
+    return item_size > free ? item_size - free : 1;
+  }
 };
 
 template <typename T>
@@ -215,6 +690,16 @@ class RingBufferByteDynamic : public RingBufferByteBase<T> {
 template <typename T, uint32_t LENGTH>
 class RingBufferByteStatic : public RingBufferByteBase<T> {
   public:
+  static constexpr uint32_t storageBytes() { return LENGTH; }
+  static constexpr uint32_t controlBlockBytes() {
+    return sizeof(RingBufferByteStatic) - storageBytes();
+  }
+
+  // Chunks of avg_size bytes that fit at once, byte buffers have no item headers
+  static constexpr uint32_t capacityItems(const uint32_t avg_size = 1) {
+    return avg_size ? LENGTH / avg_size : 0;
+  }
+
   RingBufferByteStatic()
       : RingBufferByteBase<T>(
           xRingbufferCreateStatic(LENGTH, RINGBUF_TYPE_BYTEBUF, _storage, &_tcb)) {}
@@ -224,6 +709,43 @@ class RingBufferByteStatic : public RingBufferByteBase<T> {
   uint8_t _storage[LENGTH];
 };
 
+// Like RingBufferByteStatic, with the storage placed according to MEMORY (see RTOScppMemory.h). The
+// control block is allocated from the internal heap on construction, it is not part of the object.
+// Evaluates to false if either allocation failed
+template <typename T, uint32_t LENGTH, typename MEMORY = MemoryInternal>
+class RingBufferBytePlaced : public RingBufferByteBase<T> {
+  public:
+  static constexpr uint32_t storageBytes() { return LENGTH; }
+  static constexpr uint32_t controlBlockBytes() {
+    return sizeof(RingBufferBytePlaced) + sizeof(StaticRingbuffer_t);
+  }
+
+  // Chunks of avg_size bytes that fit at once, byte buffers have no item headers
+  static constexpr uint32_t capacityItems(const uint32_t avg_size = 1) {
+    return avg_size ? LENGTH / avg_size : 0;
+  }
+
+  RingBufferBytePlaced()
+      : RingBufferByteBase<T>(nullptr)
+      , _tcb(sizeof(StaticRingbuffer_t))
+      , _storage(LENGTH) {
+    if (!_tcb || !_storage) return;
+    this->_handle = xRingbufferCreateStatic(LENGTH, RINGBUF_TYPE_BYTEBUF,
+                                            _storage.template as<uint8_t>(),
+                                            _tcb.template as<StaticRingbuffer_t>());
+  }
+
+  // The ring buffer must be deleted before its memory is released
+  ~RingBufferBytePlaced() {
+    if (this->_handle) vRingbufferDelete(this->_handle);
+    this->_handle = nullptr;
+  }
+
+  private:
+  _ControlBlock _tcb;
+  _MemoryBlock<MEMORY::CAPS> _storage;
+};
+
 template <typename T>
 class RingBufferByteExternalStorage : public RingBufferByteBase<T> {
   public:
@@ -0,0 +1,190 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "RTOScppNotify.h"
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/task.h>
+
+// Single producer, single consumer lock-free queue. The producer and the consumer can run on
+// different cores. Blocking calls wait on notification INDEX of the waiting task, away from the
+// index 0 of TaskInterface::notify*(). The peer only gives it after the waiter announced itself,
+// and a give racing with a successful retry is consumed before returning, so nothing is left
+// pending on the index. No other primitive may use INDEX of that task while it is blocked here.
+//
+// It can't be added to a QueueSet. To wait on it along other sources, give a binary semaphore
+// that is a member of the set after each add, and drain it with tryPop() when selected.
+template <typename T, uint32_t LENGTH, UBaseType_t INDEX = RTOSCPP_NOTIFY_DEFAULT_INDEX>
+class SpscQueueStatic {
+  static_assert(LENGTH > 0 && (LENGTH & (LENGTH - 1)) == 0, "LENGTH must be a power of two");
+  static_assert(INDEX > 0 && INDEX < configTASK_NOTIFICATION_ARRAY_ENTRIES,
+                "INDEX must be a notification index other than 0");
+
+  public:
+  static constexpr uint32_t CACHE_LINE_SIZE = 32;
+
+  // There is no kernel object, the indices and waiter handles count as the control block
+  static constexpr uint32_t storageBytes() { return LENGTH * sizeof(T); }
+  static constexpr uint32_t controlBlockBytes() { return sizeof(SpscQueueStatic) - storageBytes(); }
+  static constexpr uint32_t capacityItems() { return LENGTH; }
+
+  SpscQueueStatic()
+      : _head(0)
+      , _tail(0)
+      , _consumer(nullptr)
+      , _producer(nullptr) {}
+
+  SpscQueueStatic(const SpscQueueStatic&)                = delete;
+  SpscQueueStatic& operator=(const SpscQueueStatic&)     = delete;
+  SpscQueueStatic(SpscQueueStatic&&) noexcept            = delete;
+  SpscQueueStatic& operator=(SpscQueueStatic&&) noexcept = delete;
+
+  uint32_t getLength() const { return LENGTH; }
+
+  uint32_t getAvailableMessages() const {
+    return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+  }
+
+  uint32_t getAvailableSpaces() const { return LENGTH - getAvailableMessages(); }
+  bool isEmpty() const { return getAvailableMessages() == 0; }
+  bool isFull() const { return getAvailableMessages() == LENGTH; }
+
+  // Producer side
+  bool tryPush(const T& item) {
+    if (!_write(item)) return false;
+    _wake(_consumer);
+    return true;
+  }
+
+  bool add(const T& item, const TickType_t ticks_to_wait = portMAX_DELAY) {
+    if (tryPush(item)) return true;
+    if (ticks_to_wait == 0) return false;
+
+    TimeOut_t timeout;
+    TickType_t remaining = ticks_to_wait;
+    vTaskSetTimeOutState(&timeout);
+
+    while (true) {
+      _producer.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      if (tryPush(item)) {
+        _withdraw(_producer);
+        return true;
+      }
+
+      // A give consumed here was the only one, the peer cleared the announcement
+      if (ulTaskNotifyTakeIndexed(INDEX, pdTRUE, remaining) == 0) _withdraw(_producer);
+
+      if (tryPush(item)) return true;
+      if (xTaskCheckForTimeOut(&timeout, &remaining)) return false;
+    }
+  }
+
+  bool addFromISR(const T& item, BaseType_t& task_woken) {
+    if (!_write(item)) return false;
+    _wakeFromISR(_consumer, task_woken);
+    return true;
+  }
+
+  // Consumer side
+  bool tryPop(T& var) {
+    if (!_read(var)) return false;
+    _wake(_producer);
+    return true;
+  }
+
+  bool pop(T& var, const TickType_t ticks_to_wait = portMAX_DELAY) {
+    if (tryPop(var)) return true;
+    if (ticks_to_wait == 0) return false;
+
+    TimeOut_t timeout;
+    TickType_t remaining = ticks_to_wait;
+    vTaskSetTimeOutState(&timeout);
+
+    while (true) {
+      _consumer.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      if (tryPop(var)) {
+        _withdraw(_consumer);
+        return true;
+      }
+
+      // A give consumed here was the only one, the peer cleared the announcement
+      if (ulTaskNotifyTakeIndexed(INDEX, pdTRUE, remaining) == 0) _withdraw(_consumer);
+
+      if (tryPop(var)) return true;
+      if (xTaskCheckForTimeOut(&timeout, &remaining)) return false;
+    }
+  }
+
+  bool popFromISR(T& var, BaseType_t& task_woken) {
+    if (!_read(var)) return false;
+    _wakeFromISR(_producer, task_woken);
+    return true;
+  }
+
+  bool peek(T& var) const {
+    const uint32_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load(std::memory_order_acquire)) return false;
+
+    var = _storage[head & (LENGTH - 1)];
+    return true;
+  }
+
+  private:
+  bool _write(const T& item) {
+    const uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head.load(std::memory_order_acquire) == LENGTH) return false;
+
+    _storage[tail & (LENGTH - 1)] = item;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool _read(T& var) {
+    const uint32_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load(std::memory_order_acquire)) return false;
+
+    var = _storage[head & (LENGTH - 1)];
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Clears the announcement of the calling task. If the peer already took it, its give is on the
+  // way and is consumed here so it can't wake a later wait
+  static void _withdraw(std::atomic<TaskHandle_t>& waiter) {
+    if (waiter.exchange(nullptr, std::memory_order_relaxed) == nullptr) {
+      ulTaskNotifyTakeIndexed(INDEX, pdTRUE, portMAX_DELAY);
+    }
+  }
+
+  static void _wake(std::atomic<TaskHandle_t>& waiter) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiter.load(std::memory_order_relaxed) == nullptr) return;
+
+    TaskHandle_t task = waiter.exchange(nullptr, std::memory_order_relaxed);
+    if (task) xTaskNotifyGiveIndexed(task, INDEX);
+  }
+
+  static void _wakeFromISR(std::atomic<TaskHandle_t>& waiter, BaseType_t& task_woken) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiter.load(std::memory_order_relaxed) == nullptr) return;
+
+    TaskHandle_t task = waiter.exchange(nullptr, std::memory_order_relaxed);
+    if (task) vTaskNotifyGiveIndexedFromISR(task, INDEX, &task_woken);
+  }
+
+  // Head and tail are written by different cores, keep them on separate cache lines
+  alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> _head;
+  alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> _tail;
+  alignas(CACHE_LINE_SIZE) std::atomic<TaskHandle_t> _consumer;
+  std::atomic<TaskHandle_t> _producer;
+  T _storage[LENGTH];
+};
@@ -7,24 +7,75 @@
 #pragma once
 
 #include <Arduino.h>
+#include <atomic>
+#include <esp_timer.h>
+#include <freertos/semphr.h>
 #include <freertos/task.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Set to 1 to measure the latency between a notification being sent through a TaskInterface and the
+// task returning from notifyTake()/notifyWait()
+#ifndef RTOSCPP_TASK_STATS
+#define RTOSCPP_TASK_STATS 0
+#endif
+
+// Default bytes reserved for the callable of TaskCallableDynamic and TaskCallableStatic
+#ifndef RTOSCPP_TASK_CALLABLE_SIZE
+#define RTOSCPP_TASK_CALLABLE_SIZE 16
+#endif
+
+// Bucket i counts wake latencies in [2^(i-1), 2^i) us, bucket 0 counts 0 us and the last bucket
+// everything above
+static constexpr uint8_t TASK_LATENCY_BUCKETS = 12;
+
+struct TaskStats {
+  const char* name;
+  TaskHandle_t handle;
+  BaseType_t core;
+  uint8_t priority;
+  uint32_t run_time;     // Run time counter, only with configGENERATE_RUN_TIME_STATS
+  uint32_t cpu_permille; // Share of its core since the previous snapshot
+  uint32_t stack_used;
+  uint32_t stack_min;
+  uint32_t stack_max;
+  uint32_t wake_count;
+  uint32_t wake_latency_max_us;
+  uint32_t wake_latency_histogram[TASK_LATENCY_BUCKETS];
+};
 
 class TaskInterface {
   protected:
   TaskInterface(const char* name, const TaskFunction_t function, const uint8_t priority,
-                const uint32_t stack_size, const BaseType_t running_core)
+                const uint32_t stack_size, const BaseType_t running_core,
+                void* const parameter = nullptr)
       : _name(name)
       , _function(function)
+      , _parameter(parameter)
       , _priority(priority)
       , _stack_size(stack_size)
       , _running_core(running_core)
       , _handle(nullptr)
       , _stack_used(0)
       , _stack_min(0xffffffff)
-      , _stack_max(0) {}
+      , _stack_max(0)
+      , _run_time(0)
+      , _run_time_timestamp(0)
+      , _cpu_permille(0)
+      , _notify_timestamp(0)
+      , _wake_count(0)
+      , _wake_latency_max(0)
+      , _wake_latency_histogram{}
+      , _next(nullptr)
+      , _pins(0)
+      , _unpinned(nullptr) {
+    _register();
+  }
 
   const char* _name;
   const TaskFunction_t _function;
+  void* const _parameter;
   uint8_t _priority;
   const uint32_t _stack_size;
   const BaseType_t _running_core;
@@ -32,9 +83,20 @@ class TaskInterface {
   uint32_t _stack_used;
   uint32_t _stack_min;
   uint32_t _stack_max;
+  uint32_t _run_time;
+  uint32_t _run_time_timestamp;
+  uint32_t _cpu_permille;
+  mutable std::atomic<uint32_t> _notify_timestamp;
+  mutable uint32_t _wake_count;
+  mutable uint32_t _wake_latency_max;
+  mutable uint32_t _wake_latency_histogram[TASK_LATENCY_BUCKETS];
+  TaskInterface* _next;
+  uint32_t _pins;
+  SemaphoreHandle_t _unpinned;
 
   public:
   virtual ~TaskInterface() {
+    _unregister();
     if (_handle) vTaskDelete(_handle);
   }
 
@@ -63,36 +125,48 @@ class TaskInterface {
   uint32_t getStackSize() const { return _stack_size; }
 
   bool notify(const uint32_t value, const eNotifyAction action) {
+    _markNotify();
     return xTaskNotify(_handle, value, action);
   }
 
   bool notifyFromISR(const uint32_t value, const eNotifyAction action,
                      BaseType_t& task_woken) const {
+    _markNotify();
     return xTaskNotifyFromISR(_handle, value, action, &task_woken);
   }
 
   bool notifyAndQuery(const uint32_t value, const eNotifyAction action, uint32_t& old_value) const {
+    _markNotify();
     return xTaskNotifyAndQuery(_handle, value, action, &old_value);
   }
 
   bool notifyAndQueryFromISR(const uint32_t value, const eNotifyAction action, uint32_t& old_value,
                              BaseType_t& task_woken) const {
+    _markNotify();
     return xTaskNotifyAndQueryFromISR(_handle, value, action, &old_value, &task_woken);
   }
 
   bool notifyWait(const uint32_t clear_on_entry, const uint32_t clear_on_exit,
                   uint32_t* const value, const TickType_t ticks_to_wait = portMAX_DELAY) const {
-    return xTaskNotifyWait(clear_on_entry, clear_on_exit, value, ticks_to_wait);
+    const bool notified = xTaskNotifyWait(clear_on_entry, clear_on_exit, value, ticks_to_wait);
+    if (notified) _markWake();
+    return notified;
   }
 
-  bool notifyGive() const { return xTaskNotifyGive(_handle); }
+  bool notifyGive() const {
+    _markNotify();
+    return xTaskNotifyGive(_handle);
+  }
 
   void notifyGiveFromISR(BaseType_t& task_woken) const {
+    _markNotify();
     vTaskNotifyGiveFromISR(_handle, &task_woken);
   }
 
   uint32_t notifyTake(const bool clear, const TickType_t ticks_to_wait = portMAX_DELAY) const {
-    return ulTaskNotifyTake(clear, ticks_to_wait);
+    const uint32_t value = ulTaskNotifyTake(clear, ticks_to_wait);
+    if (value) _markWake();
+    return value;
   }
 
   void updateStackStats() {
@@ -105,31 +179,248 @@ class TaskInterface {
   uint32_t getStackMinUsed() const { return _stack_min; }
   uint32_t getStackMaxUsed() const { return _stack_max; }
 
+  // Updates the CPU share of the task on its core since the previous call
+  void updateRunTimeStats() {
+#if configGENERATE_RUN_TIME_STATS
+    if (_handle == nullptr) return;
+
+    TaskStatus_t status;
+    vTaskGetInfo(_handle, &status, pdFALSE, eInvalid);
+
+    const uint32_t now     = portGET_RUN_TIME_COUNTER_VALUE();
+    const uint32_t elapsed = now - _run_time_timestamp;
+
+    if (_run_time_timestamp != 0 && elapsed != 0) {
+      _cpu_permille = (uint64_t)(status.ulRunTimeCounter - _run_time) * 1000 / elapsed;
+    }
+
+    _run_time           = status.ulRunTimeCounter;
+    _run_time_timestamp = now;
+#endif
+  }
+
+  TaskStats getStats() {
+    updateStackStats();
+    updateRunTimeStats();
+
+    TaskStats stats;
+    stats.name                = _name;
+    stats.handle              = _handle;
+    stats.core                = _running_core;
+    stats.priority            = _priority;
+    stats.run_time            = _run_time;
+    stats.cpu_permille        = _cpu_permille;
+    stats.stack_used          = _stack_used;
+    stats.stack_min           = _stack_min;
+    stats.stack_max           = _stack_max;
+    stats.wake_count          = _wake_count;
+    stats.wake_latency_max_us = _wake_latency_max;
+    memcpy(stats.wake_latency_histogram, _wake_latency_histogram, sizeof(_wake_latency_histogram));
+    return stats;
+  }
+
+  void resetWakeStats() {
+    _wake_count       = 0;
+    _wake_latency_max = 0;
+    memset(_wake_latency_histogram, 0, sizeof(_wake_latency_histogram));
+  }
+
+  // Registry of every task object alive. The task given to the callback is pinned, a task
+  // destroyed meanwhile blocks in its destructor until the callback returns. The callback must not
+  // destroy tasks itself, this is asserted
+  static void forEach(void (*callback)(TaskInterface& task, void* arg), void* arg = nullptr) {
+    _Walk walk = {xTaskGetCurrentTaskHandle(), nullptr};
+
+    portENTER_CRITICAL_SAFE(&_registryMux());
+    walk.next        = _registryWalks();
+    _registryWalks() = &walk;
+
+    TaskInterface* task = _registryHead();
+    if (task) task->_pins++;
+    portEXIT_CRITICAL_SAFE(&_registryMux());
+
+    while (task != nullptr) {
+      callback(*task, arg);
+
+      // The next one is pinned before the current one is released, so it can't be unlinked
+      portENTER_CRITICAL_SAFE(&_registryMux());
+      TaskInterface* const next = task->_next;
+      if (next) next->_pins++;
+      const SemaphoreHandle_t unpinned = task->_unpin();
+      portEXIT_CRITICAL_SAFE(&_registryMux());
+
+      if (unpinned) xSemaphoreGive(unpinned);
+      task = next;
+    }
+
+    portENTER_CRITICAL_SAFE(&_registryMux());
+    for (_Walk** entry = &_registryWalks(); *entry != nullptr; entry = &(*entry)->next) {
+      if (*entry == &walk) {
+        *entry = walk.next;
+        break;
+      }
+    }
+    portEXIT_CRITICAL_SAFE(&_registryMux());
+  }
+
+  // Fills up to max_tasks snapshots, returns the number of snapshots written
+  static uint32_t getAllStats(TaskStats* const stats, const uint32_t max_tasks) {
+    struct Context {
+      TaskStats* stats;
+      uint32_t max_tasks;
+      uint32_t count;
+    } context = {stats, max_tasks, 0};
+
+    forEach([](TaskInterface& task, void* arg) {
+      Context& context = *static_cast<Context*>(arg);
+      if (context.count < context.max_tasks) context.stats[context.count++] = task.getStats();
+    }, &context);
+
+    return context.count;
+  }
+
+  static uint32_t getTaskCount() {
+    uint32_t count = 0;
+
+    portENTER_CRITICAL_SAFE(&_registryMux());
+    for (TaskInterface* task = _registryHead(); task != nullptr; task = task->_next) count++;
+    portEXIT_CRITICAL_SAFE(&_registryMux());
+
+    return count;
+  }
+
   explicit operator bool() const { return _handle != nullptr; }
+
+  private:
+  // A forEach() in progress, so a callback destroying a task can be caught
+  struct _Walk {
+    TaskHandle_t walker;
+    _Walk* next;
+  };
+
+  static TaskInterface*& _registryHead() {
+    static TaskInterface* head = nullptr;
+    return head;
+  }
+
+  static _Walk*& _registryWalks() {
+    static _Walk* head = nullptr;
+    return head;
+  }
+
+  static portMUX_TYPE& _registryMux() {
+    static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    return mux;
+  }
+
+  void _register() {
+    portENTER_CRITICAL_SAFE(&_registryMux());
+    _next           = _registryHead();
+    _registryHead() = this;
+    portEXIT_CRITICAL_SAFE(&_registryMux());
+  }
+
+  static bool _isWalking(const TaskHandle_t task) {
+    for (_Walk* walk = _registryWalks(); walk != nullptr; walk = walk->next) {
+      if (walk->walker == task) return true;
+    }
+    return false;
+  }
+
+  // Called with the registry locked. Returns the semaphore to give if a destructor waits for the
+  // last pin to go
+  SemaphoreHandle_t _unpin() {
+    if (--_pins != 0 || _unpinned == nullptr) return nullptr;
+
+    const SemaphoreHandle_t unpinned = _unpinned;
+    _unpinned                        = nullptr;
+    return unpinned;
+  }
+
+  // Waits for forEach() to release the task before unlinking it. The destroying task blocks on a
+  // semaphore living on its own stack, given by the last unpin
+  void _unregister() {
+    SemaphoreHandle_t unpinned = nullptr;
+    StaticSemaphore_t unpinned_buffer;
+
+    portENTER_CRITICAL_SAFE(&_registryMux());
+
+    if (_pins != 0) {
+      configASSERT(!_isWalking(xTaskGetCurrentTaskHandle()));
+      portEXIT_CRITICAL_SAFE(&_registryMux());
+
+      configASSERT(xTaskGetSchedulerState() == taskSCHEDULER_RUNNING);
+      unpinned = xSemaphoreCreateBinaryStatic(&unpinned_buffer);
+
+      portENTER_CRITICAL_SAFE(&_registryMux());
+      while (_pins != 0) {
+        _unpinned = unpinned;
+        portEXIT_CRITICAL_SAFE(&_registryMux());
+        xSemaphoreTake(unpinned, portMAX_DELAY);
+        portENTER_CRITICAL_SAFE(&_registryMux());
+      }
+    }
+
+    for (TaskInterface** task = &_registryHead(); *task != nullptr; task = &(*task)->_next) {
+      if (*task == this) {
+        *task = _next;
+        break;
+      }
+    }
+    portEXIT_CRITICAL_SAFE(&_registryMux());
+
+    if (unpinned) vSemaphoreDelete(unpinned);
+  }
+
+  void _markNotify() const {
+#if RTOSCPP_TASK_STATS
+    const uint32_t now = (uint32_t)esp_timer_get_time();
+    _notify_timestamp.store(now ? now : 1, std::memory_order_relaxed);
+#endif
+  }
+
+  void _markWake() const {
+#if RTOSCPP_TASK_STATS
+    const uint32_t timestamp = _notify_timestamp.exchange(0, std::memory_order_relaxed);
+    if (timestamp == 0) return;
+
+    const uint32_t latency = (uint32_t)esp_timer_get_time() - timestamp;
+    uint8_t bucket         = 0;
+    while (bucket < TASK_LATENCY_BUCKETS - 1 && (latency >> bucket) != 0) bucket++;
+
+    _wake_count++;
+    _wake_latency_max = max(_wake_latency_max, latency);
+    _wake_latency_histogram[bucket]++;
+#endif
+  }
 };
 
 class TaskDynamic : public TaskInterface {
   public:
   TaskDynamic(const char* name, TaskFunction_t function, uint8_t priority, uint32_t stack_size,
-              BaseType_t running_core = ARDUINO_RUNNING_CORE)
-      : TaskInterface(name, function, priority, stack_size, running_core) {}
+              BaseType_t running_core = ARDUINO_RUNNING_CORE, void* parameter = nullptr)
+      : TaskInterface(name, function, priority, stack_size, running_core, parameter) {}
 
   bool init() {
     return xTaskCreatePinnedToCore(
-             _function, _name, _stack_size, nullptr, _priority, &_handle, _running_core) == pdPASS;
+             _function, _name, _stack_size, _parameter, _priority, &_handle, _running_core) ==
+           pdPASS;
   }
 };
 
 template <uint32_t STACK_SIZE>
 class TaskStatic : public TaskInterface {
   public:
+  static constexpr uint32_t storageBytes() { return STACK_SIZE * sizeof(StackType_t); }
+  static constexpr uint32_t controlBlockBytes() { return sizeof(TaskStatic) - storageBytes(); }
+
   TaskStatic(const char* name, TaskFunction_t function, uint8_t priority,
-             BaseType_t running_core = ARDUINO_RUNNING_CORE)
-      : TaskInterface(name, function, priority, STACK_SIZE, running_core) {}
+             BaseType_t running_core = ARDUINO_RUNNING_CORE, void* parameter = nullptr)
+      : TaskInterface(name, function, priority, STACK_SIZE, running_core, parameter) {}
 
   bool init() {
     _handle = xTaskCreateStaticPinnedToCore(
-      _function, _name, _stack_size, nullptr, _priority, _stack, &_tcb, _running_core);
+      _function, _name, _stack_size, _parameter, _priority, _stack, &_tcb, _running_core);
 
     return _handle != nullptr;
   }
@@ -137,4 +428,67 @@ class TaskStatic : public TaskInterface {
   private:
   StaticTask_t _tcb;
   StackType_t _stack[STACK_SIZE];
-};
\ No newline at end of file
+};
+
+// Inline storage for the callable of TaskCallableDynamic and TaskCallableStatic. It is their first
+// base, so the task is deleted by TaskInterface before the callable is destroyed
+template <uint32_t CALLABLE_SIZE>
+class _TaskCallable {
+  protected:
+  template <typename F>
+  explicit _TaskCallable(F&& callable) {
+    typedef typename std::decay<F>::type Callable;
+    static_assert(sizeof(Callable) <= CALLABLE_SIZE, "Callable too large, increase CALLABLE_SIZE");
+    static_assert(alignof(Callable) <= alignof(_Storage), "Callable alignment not supported");
+
+    new (&_callable) Callable(std::forward<F>(callable));
+    _invoke  = [](void* object) { (*static_cast<Callable*>(object))(); };
+    _destroy = [](void* object) { static_cast<Callable*>(object)->~Callable(); };
+  }
+
+  ~_TaskCallable() { _destroy(&_callable); }
+
+  // A task whose callable returns suspends itself, it is deleted with the object. The task never
+  // touches the object after the callable returns, so this doesn't race with the destructor
+  static void _entry(void* parameter) {
+    _TaskCallable& self = *static_cast<_TaskCallable*>(parameter);
+    self._invoke(&self._callable);
+
+    while (true) vTaskSuspend(nullptr);
+  }
+
+  typedef typename std::aligned_storage<CALLABLE_SIZE, alignof(void*)>::type _Storage;
+
+  _Storage _callable;
+  void (*_invoke)(void* callable);
+  void (*_destroy)(void* callable);
+};
+
+// The callable (e.g. a capturing lambda) is stored inline and called with no arguments as the task
+// body, so per-task state travels with it instead of living in globals. Only these classes carry
+// the storage, TaskDynamic and TaskStatic don't
+template <uint32_t CALLABLE_SIZE = RTOSCPP_TASK_CALLABLE_SIZE>
+class TaskCallableDynamic : private _TaskCallable<CALLABLE_SIZE>, public TaskDynamic {
+  typedef _TaskCallable<CALLABLE_SIZE> _Callable;
+
+  public:
+  template <typename F>
+  TaskCallableDynamic(const char* name, F&& callable, uint8_t priority, uint32_t stack_size,
+                      BaseType_t running_core = ARDUINO_RUNNING_CORE)
+      : _Callable(std::forward<F>(callable))
+      , TaskDynamic(name, &_Callable::_entry, priority, stack_size, running_core,
+                    static_cast<_Callable*>(this)) {}
+};
+
+template <uint32_t STACK_SIZE, uint32_t CALLABLE_SIZE = RTOSCPP_TASK_CALLABLE_SIZE>
+class TaskCallableStatic : private _TaskCallable<CALLABLE_SIZE>, public TaskStatic<STACK_SIZE> {
+  typedef _TaskCallable<CALLABLE_SIZE> _Callable;
+
+  public:
+  template <typename F>
+  TaskCallableStatic(const char* name, F&& callable, uint8_t priority,
+                     BaseType_t running_core = ARDUINO_RUNNING_CORE)
+      : _Callable(std::forward<F>(callable))
+      , TaskStatic<STACK_SIZE>(name, &_Callable::_entry, priority, running_core,
+                               static_cast<_Callable*>(this)) {}
+};
@@ -0,0 +1,226 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "RTOScppTask.h"
+#include <Arduino.h>
+#include <atomic>
+#include <new>
+#include <type_traits>
+
+struct TaskPoolJob {
+  void (*function)(void* context);
+  void* context;
+};
+
+// Bounded lock-free queue with multiple producers and consumers, so both submitters and thieves
+// can use it without locks
+template <uint32_t LENGTH>
+class _TaskPoolQueue {
+  static_assert(LENGTH > 0 && (LENGTH & (LENGTH - 1)) == 0, "LENGTH must be a power of two");
+
+  public:
+  _TaskPoolQueue()
+      : _enqueue_pos(0)
+      , _dequeue_pos(0) {
+    for (uint32_t i = 0; i < LENGTH; i++) _cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  bool push(const TaskPoolJob& job) {
+    uint32_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+    _Cell* cell;
+
+    while (true) {
+      cell               = &_cells[pos & (LENGTH - 1)];
+      const int32_t diff = cell->sequence.load(std::memory_order_acquire) - pos;
+
+      if (diff == 0) {
+        if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = _enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->job = job;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(TaskPoolJob& job) {
+    uint32_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+    _Cell* cell;
+
+    while (true) {
+      cell               = &_cells[pos & (LENGTH - 1)];
+      const int32_t diff = cell->sequence.load(std::memory_order_acquire) - (pos + 1);
+
+      if (diff == 0) {
+        if (_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = _dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+
+    job = cell->job;
+    cell->sequence.store(pos + LENGTH, std::memory_order_release);
+    return true;
+  }
+
+  private:
+  struct _Cell {
+    std::atomic<uint32_t> sequence;
+    TaskPoolJob job;
+  };
+
+  _Cell _cells[LENGTH];
+  std::atomic<uint32_t> _enqueue_pos;
+  std::atomic<uint32_t> _dequeue_pos;
+};
+
+// Pool of WORKERS static tasks spread over both cores. Each worker runs the jobs of its own queue
+// and steals from the other workers when it runs out. Workers sleep on their task notification
+// (index 0) while there is nothing to run
+template <uint8_t WORKERS, uint32_t STACK_SIZE, uint32_t QUEUE_LENGTH = 16>
+class TaskPool {
+  static_assert(WORKERS > 0 && WORKERS <= 32, "WORKERS must be between 1 and 32");
+
+  public:
+  TaskPool(const char* name, const uint8_t priority)
+      : _next_worker(0)
+      , _sleeping(0) {
+    for (uint8_t i = 0; i < WORKERS; i++) {
+      _workers[i].pool     = this;
+      _workers[i].index    = i;
+      _workers[i].executed = 0;
+      _workers[i].stolen   = 0;
+      new (&_tasks[i]) TaskStatic<STACK_SIZE>(
+        name, &TaskPool::_run, priority, i % portNUM_PROCESSORS, &_workers[i]);
+    }
+  }
+
+  ~TaskPool() {
+    for (uint8_t i = 0; i < WORKERS; i++) _task(i).~TaskStatic<STACK_SIZE>();
+  }
+
+  TaskPool(const TaskPool&)                = delete;
+  TaskPool& operator=(const TaskPool&)     = delete;
+  TaskPool(TaskPool&&) noexcept            = delete;
+  TaskPool& operator=(TaskPool&&) noexcept = delete;
+
+  bool init() {
+    for (uint8_t i = 0; i < WORKERS; i++) {
+      if (!_task(i).init()) return false;
+    }
+    return true;
+  }
+
+  // Returns false if the queue of every worker is full
+  bool submit(void (*function)(void* context), void* context = nullptr) {
+    const int8_t worker = _enqueue({function, context});
+    if (worker < 0) return false;
+
+    const uint32_t target = _wakeTarget(worker);
+    if (target < WORKERS) _task(target).notifyGive();
+    return true;
+  }
+
+  bool submitFromISR(void (*function)(void* context), void* context, BaseType_t& task_woken) {
+    const int8_t worker = _enqueue({function, context});
+    if (worker < 0) return false;
+
+    const uint32_t target = _wakeTarget(worker);
+    if (target < WORKERS) _task(target).notifyGiveFromISR(task_woken);
+    return true;
+  }
+
+  TaskInterface& getWorker(const uint8_t index) { return _task(index); }
+  uint32_t getExecuted(const uint8_t index) const { return _workers[index].executed; }
+  uint32_t getStolen(const uint8_t index) const { return _workers[index].stolen; }
+
+  private:
+  struct _Worker {
+    TaskPool* pool;
+    uint8_t index;
+    uint32_t executed;
+    uint32_t stolen;
+    _TaskPoolQueue<QUEUE_LENGTH> queue;
+  };
+
+  TaskStatic<STACK_SIZE>& _task(const uint8_t index) {
+    return *reinterpret_cast<TaskStatic<STACK_SIZE>*>(&_tasks[index]);
+  }
+
+  // Round-robin over the workers, skipping full queues
+  int8_t _enqueue(const TaskPoolJob& job) {
+    const uint32_t first = _next_worker.fetch_add(1, std::memory_order_relaxed);
+
+    for (uint8_t i = 0; i < WORKERS; i++) {
+      const uint8_t worker = (first + i) % WORKERS;
+      if (_workers[worker].queue.push(job)) return worker;
+    }
+
+    return -1;
+  }
+
+  // Wakes the owner of the job if it sleeps, otherwise any sleeping worker so it can steal it.
+  // Returns WORKERS if everybody is busy
+  uint32_t _wakeTarget(const uint8_t worker) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const uint32_t sleeping = _sleeping.load(std::memory_order_relaxed);
+
+    if (sleeping == 0) return WORKERS;
+    if (sleeping & (1UL << worker)) return worker;
+    return __builtin_ctz(sleeping);
+  }
+
+  bool _next(_Worker& worker, TaskPoolJob& job) {
+    if (worker.queue.pop(job)) return true;
+
+    for (uint8_t i = 1; i < WORKERS; i++) {
+      if (_workers[(worker.index + i) % WORKERS].queue.pop(job)) {
+        worker.stolen++;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  static void _run(void* parameter) {
+    _Worker& worker    = *static_cast<_Worker*>(parameter);
+    TaskPool& pool     = *worker.pool;
+    const uint32_t bit = 1UL << worker.index;
+    TaskPoolJob job;
+
+    while (true) {
+      if (!pool._next(worker, job)) {
+        pool._sleeping.fetch_or(bit, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        // Check again, a job may have been submitted before the sleeping bit was visible
+        const bool found = pool._next(worker, job);
+        if (!found) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        pool._sleeping.fetch_and(~bit, std::memory_order_relaxed);
+        if (!found) continue;
+      }
+
+      job.function(job.context);
+      worker.executed++;
+    }
+  }
+
+  _Worker _workers[WORKERS];
+  typename std::aligned_storage<sizeof(TaskStatic<STACK_SIZE>),
+                                alignof(TaskStatic<STACK_SIZE>)>::type _tasks[WORKERS];
+  std::atomic<uint32_t> _next_worker;
+  std::atomic<uint32_t> _sleeping;
+};
@@ -24,7 +24,7 @@ class TimerInterface {
 
   public:
   virtual ~TimerInterface() {
-    if (_handle) vTaskDelete(_handle);
+    if (_handle) xTimerDelete(_handle, portMAX_DELAY);
   }
 
   TimerInterface(const TimerInterface&)                = delete;
@@ -112,6 +112,9 @@ class TimerDynamic : public TimerInterface {
 
 class TimerStatic : public TimerInterface {
   public:
+  static constexpr uint32_t storageBytes() { return 0; }
+  static constexpr uint32_t controlBlockBytes() { return sizeof(TimerStatic); }
+
   TimerStatic()
       : TimerInterface(nullptr) {}
 
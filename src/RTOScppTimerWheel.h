@@ -0,0 +1,244 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "RTOScppTimer.h"
+#include <Arduino.h>
+
+class TimerWheel;
+class TimerWheelEntry;
+
+typedef void (*TimerWheelCallback_t)(TimerWheelEntry& entry);
+
+// Lightweight software timer driven by a TimerWheel. Same setup model as TimerInterface, but
+// starting, stopping or resetting it doesn't post anything to the timer daemon queue
+class TimerWheelEntry {
+  public:
+  TimerWheelEntry()
+      : _name(nullptr)
+      , _callback(nullptr)
+      , _period(0)
+      , _id(nullptr)
+      , _auto_reload(false)
+      , _expiry(0)
+      , _prev(nullptr)
+      , _next(nullptr)
+      , _slot(nullptr) {}
+
+  TimerWheelEntry(const TimerWheelEntry&)                = delete;
+  TimerWheelEntry& operator=(const TimerWheelEntry&)     = delete;
+  TimerWheelEntry(TimerWheelEntry&&) noexcept            = delete;
+  TimerWheelEntry& operator=(TimerWheelEntry&&) noexcept = delete;
+
+  void setup(const char* name, const TimerWheelCallback_t callback, const TickType_t period,
+             void* id, const bool auto_reload) {
+    _name        = name;
+    _callback    = callback;
+    _period      = period;
+    _id          = id;
+    _auto_reload = auto_reload;
+  }
+
+  const char* getName() const { return _name; }
+  TickType_t getPeriod() const { return _period; }
+  void setTimerID(void* id) { _id = id; }
+  void* getTimerID() const { return _id; }
+  void setReloadMode(const bool auto_reload) { _auto_reload = auto_reload; }
+  bool getReloadMode() const { return _auto_reload; }
+  bool isActive() const { return _slot != nullptr; }
+
+  private:
+  friend class TimerWheel;
+
+  const char* _name;
+  TimerWheelCallback_t _callback;
+  TickType_t _period;
+  void* _id;
+  bool _auto_reload;
+  uint32_t _expiry;
+  TimerWheelEntry* _prev;
+  TimerWheelEntry* _next;
+  TimerWheelEntry** _slot;
+};
+
+// Hierarchical timing wheel: LEVELS levels of SLOTS lists, each level SLOTS times coarser than the
+// previous one. Arming and cancelling an entry is O(1), and each wheel step only visits the lists
+// that expire or cascade. The wheel is driven by an internal TimerStatic (start()) or by calling
+// process() periodically from a task. Entry callbacks run in the context calling process()
+class TimerWheel {
+  public:
+  static constexpr uint8_t BITS       = 6;
+  static constexpr uint8_t LEVELS     = 4;
+  static constexpr uint32_t SLOTS     = 1UL << BITS;
+  static constexpr uint32_t MAX_TICKS = (1UL << (BITS * LEVELS)) - 1;
+
+  // resolution is the length of a wheel step in RTOS ticks
+  TimerWheel(const TickType_t resolution = 1)
+      : _resolution(resolution ? resolution : 1)
+      , _now(0)
+      , _last_tick(xTaskGetTickCount())
+      , _active(0)
+      , _slots{} {
+    portMUX_INITIALIZE(&_mux);
+  }
+
+  TimerWheel(const TimerWheel&)                = delete;
+  TimerWheel& operator=(const TimerWheel&)     = delete;
+  TimerWheel(TimerWheel&&) noexcept            = delete;
+  TimerWheel& operator=(TimerWheel&&) noexcept = delete;
+
+  // Drives the wheel from a single auto reload TimerStatic, the only daemon queue traffic
+  bool start(const char* name = "TimerWheel") {
+    _last_tick = xTaskGetTickCount();
+    _timer.setup(name, &TimerWheel::_onTimer, _resolution, this, true, true);
+    return _timer.create();
+  }
+
+  bool stopDriver(const TickType_t ticks_to_wait = portMAX_DELAY) {
+    return _timer.stop(ticks_to_wait);
+  }
+
+  // Arms the entry to expire after its period, restarting it if was already active. Returns false
+  // if the period doesn't fit in the wheel
+  bool start(TimerWheelEntry& entry) { return reset(entry); }
+
+  bool reset(TimerWheelEntry& entry) {
+    const uint32_t steps = _toSteps(entry._period);
+    if (steps > MAX_TICKS) return false;
+
+    portENTER_CRITICAL(&_mux);
+    if (entry.isActive()) _unlink(entry);
+    entry._expiry = _now + steps;
+    _link(entry);
+    portEXIT_CRITICAL(&_mux);
+    return true;
+  }
+
+  bool setPeriod(TimerWheelEntry& entry, const TickType_t period) {
+    entry._period = period;
+    return reset(entry);
+  }
+
+  void stop(TimerWheelEntry& entry) {
+    portENTER_CRITICAL(&_mux);
+    if (entry.isActive()) _unlink(entry);
+    portEXIT_CRITICAL(&_mux);
+  }
+
+  // Remaining RTOS ticks until the entry expires, 0 if it isn't active
+  TickType_t getRemaining(const TimerWheelEntry& entry) {
+    portENTER_CRITICAL(&_mux);
+    const uint32_t steps = entry.isActive() ? entry._expiry - _now : 0;
+    portEXIT_CRITICAL(&_mux);
+    return steps * _resolution;
+  }
+
+  // Steps the wheel up to the current tick count and runs the callbacks of the expired entries
+  void process() {
+    const TickType_t now = xTaskGetTickCount();
+
+    while (now - _last_tick >= _resolution) {
+      _last_tick += _resolution;
+      _step();
+    }
+  }
+
+  uint32_t getActiveCount() const { return _active; }
+  TickType_t getResolution() const { return _resolution; }
+
+  private:
+  static void _onTimer(TimerHandle_t timer) {
+    static_cast<TimerWheel*>(pvTimerGetTimerID(timer))->process();
+  }
+
+  uint32_t _toSteps(const TickType_t ticks) const {
+    const uint32_t steps = (ticks + _resolution - 1) / _resolution;
+    return steps ? steps : 1;
+  }
+
+  // Both must be called inside the critical section
+  void _link(TimerWheelEntry& entry) {
+    const uint32_t delta = entry._expiry - _now;
+
+    uint8_t level = 0;
+    while (level < LEVELS - 1 && delta >= (1UL << (BITS * (level + 1)))) level++;
+
+    TimerWheelEntry** slot = &_slots[level][(entry._expiry >> (BITS * level)) & (SLOTS - 1)];
+
+    entry._prev = nullptr;
+    entry._next = *slot;
+    entry._slot = slot;
+    if (*slot) (*slot)->_prev = &entry;
+    *slot = &entry;
+    _active++;
+  }
+
+  void _unlink(TimerWheelEntry& entry) {
+    if (entry._prev) {
+      entry._prev->_next = entry._next;
+    } else {
+      *entry._slot = entry._next;
+    }
+
+    if (entry._next) entry._next->_prev = entry._prev;
+
+    entry._prev = entry._next = nullptr;
+    entry._slot               = nullptr;
+    _active--;
+  }
+
+  void _step() {
+    portENTER_CRITICAL(&_mux);
+    const uint32_t now = ++_now;
+
+    // Levels whose lower bits wrapped move their current list one level down, coarser levels first
+    // so their entries can cascade again in the same step
+    uint8_t top = 0;
+    while (top < LEVELS - 1 && (now & ((1UL << (BITS * (top + 1))) - 1)) == 0) top++;
+
+    for (uint8_t level = top; level > 0; level--) {
+      TimerWheelEntry** slot = &_slots[level][(now >> (BITS * level)) & (SLOTS - 1)];
+
+      while (*slot) {
+        TimerWheelEntry& entry = **slot;
+        _unlink(entry);
+        _link(entry);
+      }
+    }
+
+    // Expired entries are taken one at a time so callbacks run outside the critical section and
+    // can arm and cancel entries freely
+    TimerWheelEntry** slot = &_slots[0][now & (SLOTS - 1)];
+
+    while (*slot) {
+      TimerWheelEntry& entry = **slot;
+      _unlink(entry);
+
+      if (entry._auto_reload) {
+        entry._expiry = now + _toSteps(entry._period);
+        _link(entry);
+      }
+
+      const TimerWheelCallback_t callback = entry._callback;
+      portEXIT_CRITICAL(&_mux);
+
+      if (callback) callback(entry);
+
+      portENTER_CRITICAL(&_mux);
+    }
+
+    portEXIT_CRITICAL(&_mux);
+  }
+
+  const TickType_t _resolution;
+  uint32_t _now;
+  TickType_t _last_tick;
+  uint32_t _active;
+  portMUX_TYPE _mux;
+  TimerWheelEntry* _slots[LEVELS][SLOTS];
+  TimerStatic _timer;
+};
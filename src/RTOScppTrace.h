@@ -0,0 +1,187 @@
+/**
+ * SPDX-FileCopyrightText: 2024 Maximiliano Ramirez
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <esp_timer.h>
+#include <freertos/task.h>
+
+// Set to 1 in the build flags to record the blocking calls of queues, locks and buffers. It must
+// have the same value in every translation unit. When disabled the wrappers compile to the plain
+// FreeRTOS calls
+#ifndef RTOSCPP_TRACE
+#define RTOSCPP_TRACE 0
+#endif
+
+// Events kept per core, must be a power of two
+#ifndef RTOSCPP_TRACE_EVENTS
+#define RTOSCPP_TRACE_EVENTS 256
+#endif
+
+enum class TraceOp : uint8_t {
+  QueueAdd,
+  QueuePush,
+  QueuePop,
+  QueuePeek,
+  LockTake,
+  LockGive,
+  BufferSend,
+  BufferReceive,
+  RingBufferSend,
+};
+
+struct TraceEvent {
+  uint32_t timestamp_us;
+  const void* object;
+  TickType_t ticks_waited;
+  TraceOp op;
+  bool result;
+  uint8_t core;
+};
+
+class TraceRecorder {
+  static_assert((RTOSCPP_TRACE_EVENTS & (RTOSCPP_TRACE_EVENTS - 1)) == 0,
+                "RTOSCPP_TRACE_EVENTS must be a power of two");
+
+  public:
+  static constexpr uint32_t EVENTS = RTOSCPP_TRACE_EVENTS;
+
+  static void record(const void* const object, const TraceOp op, const TickType_t ticks_waited,
+                     const bool result) {
+    const uint8_t core = xPortGetCoreID();
+    _Ring& ring        = _rings()[core];
+
+    // Writers on the same core (tasks and ISRs) only race for the slot index. The sequence of the
+    // slot holds the index while the event is written and index + 1 once it is complete
+    const uint32_t index = ring.head.fetch_add(1, std::memory_order_relaxed);
+    _Slot& slot          = ring.slots[index & (EVENTS - 1)];
+    slot.sequence.store(index, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.event.timestamp_us = (uint32_t)esp_timer_get_time();
+    slot.event.object       = object;
+    slot.event.ticks_waited = ticks_waited;
+    slot.event.op           = op;
+    slot.event.result       = result;
+    slot.event.core         = core;
+
+    slot.sequence.store(index + 1, std::memory_order_release);
+  }
+
+  // Copies the events of a core not read yet, oldest first. Only one reader per core is supported.
+  // Events overwritten before being read are added to getDropped(). Stops at an event still being
+  // written, it is returned by a later call
+  static uint32_t read(const uint8_t core, TraceEvent* const events, const uint32_t max_events) {
+    if (core >= portNUM_PROCESSORS) return 0;
+
+    _Ring& ring         = _rings()[core];
+    const uint32_t head = ring.head.load(std::memory_order_acquire);
+
+    if (head - ring.tail > EVENTS) {
+      ring.dropped += head - ring.tail - EVENTS;
+      ring.tail = head - EVENTS;
+    }
+
+    uint32_t count = 0;
+    while (ring.tail != head && count < max_events) {
+      _Slot& slot             = ring.slots[ring.tail & (EVENTS - 1)];
+      const uint32_t expected = ring.tail + 1;
+      const uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+
+      if ((int32_t)(sequence - expected) < 0) break;
+
+      if (sequence == expected) {
+        events[count] = slot.event;
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // Keep the copy only if no writer reached the slot meanwhile
+        if (slot.sequence.load(std::memory_order_relaxed) == expected) {
+          count++;
+          ring.tail++;
+          continue;
+        }
+      }
+
+      ring.dropped++;
+      ring.tail++;
+    }
+
+    return count;
+  }
+
+  static uint32_t getDropped(const uint8_t core) {
+    return core < portNUM_PROCESSORS ? _rings()[core].dropped : 0;
+  }
+
+  static const char* getOpName(const TraceOp op) {
+    switch (op) {
+      case TraceOp::QueueAdd: return "queue_add";
+      case TraceOp::QueuePush: return "queue_push";
+      case TraceOp::QueuePop: return "queue_pop";
+      case TraceOp::QueuePeek: return "queue_peek";
+      case TraceOp::LockTake: return "lock_take";
+      case TraceOp::LockGive: return "lock_give";
+      case TraceOp::BufferSend: return "buffer_send";
+      case TraceOp::BufferReceive: return "buffer_receive";
+      case TraceOp::RingBufferSend: return "ring_buffer_send";
+    }
+    return "unknown";
+  }
+
+  // Streams the pending events of every core as CSV lines:
+  // core,timestamp_us,object,op,ticks_waited,result
+  static uint32_t dump(Print& out) {
+    TraceEvent events[16];
+    uint32_t total = 0;
+
+    for (uint8_t core = 0; core < portNUM_PROCESSORS; core++) {
+      uint32_t count;
+      while ((count = read(core, events, 16)) != 0) {
+        for (uint32_t i = 0; i < count; i++) {
+          out.printf("%u,%u,%p,%s,%u,%u\n",
+                     (unsigned)events[i].core,
+                     (unsigned)events[i].timestamp_us,
+                     events[i].object,
+                     getOpName(events[i].op),
+                     (unsigned)events[i].ticks_waited,
+                     (unsigned)events[i].result);
+        }
+        total += count;
+      }
+    }
+
+    return total;
+  }
+
+  private:
+  struct _Slot {
+    std::atomic<uint32_t> sequence;
+    TraceEvent event;
+  };
+
+  struct _Ring {
+    std::atomic<uint32_t> head;
+    uint32_t tail;
+    uint32_t dropped;
+    _Slot slots[EVENTS];
+  };
+
+  static _Ring* _rings() {
+    static _Ring rings[portNUM_PROCESSORS];
+    return rings;
+  }
+};
+
+#if RTOSCPP_TRACE
+#define RTOSCPP_TRACE_BEGIN() const TickType_t _trace_start = xTaskGetTickCount()
+#define RTOSCPP_TRACE_END(object, op, result)                                                      \
+  TraceRecorder::record(object, op, xTaskGetTickCount() - _trace_start, result)
+#else
+#define RTOSCPP_TRACE_BEGIN()
+#define RTOSCPP_TRACE_END(object, op, result)
+#endif